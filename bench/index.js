@@ -0,0 +1,166 @@
+// Benchmarks of the Builder encoding and the Sender throughput, results are printed as JSON.
+//   npm run bench -- [--rows 1000000] [--shape mixedColumns] [--encode-only] [--output results.json]
+// Allocations are measured only if gc is exposed, the npm script runs node with --expose-gc.
+const fs = require("fs");
+const os = require("os");
+const { Builder, Sender } = require("../index");
+const { native } = require("../src/native");
+const { SHAPES } = require("./shapes");
+const { Sink } = require("./sink");
+
+const DEFAULT_ROWS = 1000000;
+const WARMUP_ROWS = 100000;
+const BUFFER_SIZE = 1048576; // 1 MB
+const ALLOCATION_SAMPLE_ROWS = 1000;
+const ALLOCATION_SAMPLES = 100;
+const HOST = "127.0.0.1";
+
+function parseArgs(argv) {
+    const args = { rows: DEFAULT_ROWS, shapes: Object.keys(SHAPES), encodeOnly: false, output: null };
+    for (let i = 0; i < argv.length; i++) {
+        switch (argv[i]) {
+            case "--rows":
+                args.rows = parseInt(argv[++i]);
+                break;
+            case "--shape":
+                args.shapes = [argv[++i]];
+                break;
+            case "--encode-only":
+                args.encodeOnly = true;
+                break;
+            case "--output":
+                args.output = argv[++i];
+                break;
+            default:
+                throw `Unknown argument: ${argv[i]}`;
+        }
+    }
+    for (const shape of args.shapes) {
+        if (!SHAPES[shape]) {
+            throw `Unknown shape: ${shape}, available shapes: ${Object.keys(SHAPES).join(", ")}`;
+        }
+    }
+    return args;
+}
+
+// writes the rows into the builder, it is reset when it gets full; returns the number of bytes encoded
+function encode(builder, shape, numOfRows) {
+    let bytes = 0;
+    for (let i = 0; i < numOfRows; i++) {
+        if (builder.position > BUFFER_SIZE - 1024) {
+            bytes += builder.position;
+            builder.reset();
+        }
+        shape(builder, i);
+    }
+    bytes += builder.position;
+    builder.reset();
+    return bytes;
+}
+
+function benchEncode(name, numOfRows) {
+    const shape = SHAPES[name];
+    const builder = new Builder(BUFFER_SIZE);
+    encode(builder, shape, WARMUP_ROWS);
+
+    const start = process.hrtime.bigint();
+    const bytes = encode(builder, shape, numOfRows);
+    const elapsed = Number(process.hrtime.bigint() - start);
+
+    return {
+        shape: name,
+        rows: numOfRows,
+        nsPerRow: round(elapsed / numOfRows),
+        rowsPerSec: Math.round(numOfRows / elapsed * 1e9),
+        bytesPerRow: round(bytes / numOfRows),
+        mbPerSec: round(bytes / elapsed * 1e9 / 1048576),
+        allocatedBytesPerRow: measureAllocations(builder, shape)
+    };
+}
+
+// Heap growth while encoding small batches of rows, samples interrupted by a gc are dropped.
+function measureAllocations(builder, shape) {
+    if (typeof global.gc !== "function") {
+        return null;
+    }
+    let allocated = 0;
+    let rows = 0;
+    for (let i = 0; i < ALLOCATION_SAMPLES; i++) {
+        global.gc();
+        const before = process.memoryUsage().heapUsed;
+        encode(builder, shape, ALLOCATION_SAMPLE_ROWS);
+        const delta = process.memoryUsage().heapUsed - before;
+        if (delta >= 0) {
+            allocated += delta;
+            rows += ALLOCATION_SAMPLE_ROWS;
+        }
+    }
+    return rows > 0 ? round(allocated / rows) : null;
+}
+
+async function benchThroughput(name, numOfRows) {
+    const shape = SHAPES[name];
+    const expectedBytes = encode(new Builder(BUFFER_SIZE), shape, numOfRows);
+
+    const sink = new Sink();
+    const port = await sink.start(0, HOST);
+    const sender = new Sender(null, { bufferSize: BUFFER_SIZE, autoFlush: true, autoFlushRows: 10000 });
+    await sender.connect(port, HOST);
+
+    const start = process.hrtime.bigint();
+    for (let i = 0; i < numOfRows; i++) {
+        await shape(sender, i);
+    }
+    await sender.flush();
+    await sink.received(expectedBytes);
+    const elapsed = Number(process.hrtime.bigint() - start);
+
+    await sender.close();
+    await sink.stop();
+    return {
+        shape: name,
+        rows: numOfRows,
+        bytes: expectedBytes,
+        rowsPerSec: Math.round(numOfRows / elapsed * 1e9),
+        mbPerSec: round(expectedBytes / elapsed * 1e9 / 1048576)
+    };
+}
+
+function round(value) {
+    return Math.round(value * 100) / 100;
+}
+
+async function run() {
+    // the sender logs connection events, it would mix with the results
+    console.log = () => {};
+    const args = parseArgs(process.argv.slice(2));
+    const results = {
+        date: new Date().toISOString(),
+        node: process.version,
+        platform: `${process.platform}-${process.arch}`,
+        cpu: os.cpus()[0].model,
+        native: !!native,
+        encode: [],
+        throughput: []
+    };
+
+    for (const shape of args.shapes) {
+        results.encode.push(benchEncode(shape, args.rows));
+    }
+    if (!args.encodeOnly) {
+        for (const shape of args.shapes) {
+            results.throughput.push(await benchThroughput(shape, args.rows));
+        }
+    }
+
+    const json = JSON.stringify(results, null, 2);
+    if (args.output) {
+        fs.writeFileSync(args.output, `${json}\n`);
+    }
+    process.stdout.write(`${json}\n`);
+}
+
+run().catch(err => {
+    console.error(err);
+    process.exit(1);
+});
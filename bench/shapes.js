@@ -0,0 +1,38 @@
+// Row shapes used by the benchmarks, each writes one row into the builder or sender.
+// The designated timestamps are in microseconds, so they stay within the safe integer range.
+const LONG_STRING = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore "
+    + "et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip";
+const CITIES = ["budapest", "london", "singapore", "new york", "sydney"];
+const UNICODE_CITIES = ["Zürich", "Kraków", "東京", "Москва", "São Paulo"];
+
+const SHAPES = {
+    symbolsOnly: (target, i) => target.addTable("sensors")
+        .addSymbol("location", "emea")
+        .addSymbol("city", CITIES[i % CITIES.length])
+        .addSymbol("device", "thermometer")
+        .atMicros(1658484765000000 + i),
+
+    mixedColumns: (target, i) => target.addTable("trades")
+        .addSymbol("pair", "BTC-USD")
+        .addSymbol("side", i % 2 ? "buy" : "sell")
+        .addFloat("price", 20654.3 + i % 100)
+        .addInteger("amount", i % 1000)
+        .addBoolean("maker", i % 3 === 0)
+        .addTimestamp("received", 1658484765000000 + i)
+        .atMicros(1658484765000000 + i),
+
+    longStrings: (target, i) => target.addTable("logs")
+        .addSymbol("level", "info")
+        .addString("message", LONG_STRING)
+        .addString("source", "service, \"api\" = handler")
+        .addInteger("id", i)
+        .atMicros(1658484765000000 + i),
+
+    unicode: (target, i) => target.addTable("weather")
+        .addSymbol("city", UNICODE_CITIES[i % UNICODE_CITIES.length])
+        .addString("description", "ciel dégagé, températures élevées ☀")
+        .addFloat("temperature", 21.5)
+        .atMicros(1658484765000000 + i)
+};
+
+exports.SHAPES = SHAPES;
@@ -0,0 +1,39 @@
+const net = require("net");
+
+// TCP server which discards everything it receives, only counts the bytes.
+// The mock proxy of the tests keeps and logs the data, which would dominate the measurement.
+class Sink {
+    constructor() {
+        this.bytes = 0;
+        this.sockets = new Set();
+        this.server = net.createServer(socket => {
+            this.sockets.add(socket);
+            socket.on("data", data => this.bytes += data.length);
+            socket.on("error", () => {});
+            socket.on("close", () => this.sockets.delete(socket));
+        });
+    }
+
+    start(port, host) {
+        return new Promise((resolve, reject) => {
+            this.server.once("error", reject);
+            this.server.listen(port, host, () => resolve(this.server.address().port));
+        });
+    }
+
+    // resolves when the sink received the given number of bytes
+    async received(bytes) {
+        while (this.bytes < bytes) {
+            await new Promise(resolve => setImmediate(resolve));
+        }
+    }
+
+    stop() {
+        for (const socket of this.sockets) {
+            socket.destroy();
+        }
+        return new Promise(resolve => this.server.close(resolve));
+    }
+}
+
+exports.Sink = Sink;
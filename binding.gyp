@@ -0,0 +1,10 @@
+{
+  "targets": [
+    {
+      "target_name": "questdb_encoder",
+      "sources": [ "src/native/encoder.c" ],
+      "cflags": [ "-O3" ],
+      "defines": [ "NAPI_VERSION=6" ]
+    }
+  ]
+}
@@ -1,5 +1,22 @@
 const { Sender } = require('./src/sender');
 const { Builder } = require('./src/builder');
+const { BatchBuilder } = require('./src/batchbuilder');
+const { BuilderPool } = require('./src/builderpool');
+const { SenderPool } = require('./src/senderpool');
+const { HttpSender } = require('./src/httpsender');
+const { WorkerBuilder, connectWorker } = require('./src/worker');
+const { SenderWritable } = require('./src/stream');
+const { configureTracing, getPhaseTimings, resetPhaseTimings } = require('./src/trace');
 
 module.exports.Sender = Sender;
 module.exports.Builder = Builder;
+module.exports.BatchBuilder = BatchBuilder;
+module.exports.BuilderPool = BuilderPool;
+module.exports.SenderPool = SenderPool;
+module.exports.HttpSender = HttpSender;
+module.exports.WorkerBuilder = WorkerBuilder;
+module.exports.connectWorker = connectWorker;
+module.exports.SenderWritable = SenderWritable;
+module.exports.configureTracing = configureTracing;
+module.exports.getPhaseTimings = getPhaseTimings;
+module.exports.resetPhaseTimings = resetPhaseTimings;
@@ -0,0 +1,94 @@
+const { Builder } = require("./builder");
+
+// Collects the rows of each table in a separate Builder, so the rows of a table are sent contiguously:
+//   batch.addTable("cpu").addSymbol("host", "a").addFloat("load", 0.5).atNow();
+//   batch.addTable("mem").addSymbol("host", "a").addInteger("free", 1024).atNow();
+//   await batch.flush(sender);
+// addTable() returns the builder of the table, the row is completed on it as usual.
+// A Sender writes the buffers of the tables to the socket with a single vectored write,
+// an HttpSender posts them in a single request. The builders are kept and reused after the flush.
+// The order of rows is kept only within a table.
+class BatchBuilder {
+    // options are passed to the Builder of each table, bufferSize is the initial size of each buffer
+    constructor(bufferSize, options = {}) {
+        this.bufferSize = bufferSize;
+        this.options = options;
+        this.builders = new Map();
+        this.current = null;
+        this.flushing = false;
+    }
+
+    addTable(table) {
+        if (this.flushing) {
+            throw "Rows cannot be added while the batch is being flushed";
+        }
+        if (this.current && this.current.hasTable) {
+            throw "Table name has already been set";
+        }
+        let builder = this.builders.get(table);
+        if (!builder) {
+            builder = new Builder(this.bufferSize, this.options);
+            this.builders.set(table, builder);
+        }
+        // the table name is validated and escaped once, then copied from the name cache of the Builder
+        builder.addTable(table);
+        this.current = builder;
+        return builder;
+    }
+
+    // discards the row being added, the rows already closed are kept
+    rollback() {
+        if (this.current) {
+            this.current.rollback();
+        }
+        return this;
+    }
+
+    // number of bytes in all buffers
+    get position() {
+        let position = 0;
+        for (const builder of this.builders.values()) {
+            position += builder.position;
+        }
+        return position;
+    }
+
+    // the content of the non-empty buffers, one per table
+    toBuffers() {
+        if (this.current && this.current.hasTable) {
+            throw "The builder's content is invalid, row needs to be closed by calling at() or atNow()";
+        }
+        const buffers = [];
+        for (const builder of this.builders.values()) {
+            if (builder.position > 0) {
+                buffers.push(builder.toBuffer());
+            }
+        }
+        return buffers;
+    }
+
+    reset() {
+        for (const builder of this.builders.values()) {
+            builder.reset();
+        }
+        this.current = null;
+        return this;
+    }
+
+    // sends the rows of all tables via the Sender or HttpSender and resets the buffers when they have been written
+    async flush(sender) {
+        const buffers = this.toBuffers();
+        if (buffers.length < 1) {
+            return;
+        }
+        this.flushing = true;
+        try {
+            await sender.sendMany(buffers);
+        } finally {
+            this.flushing = false;
+        }
+        this.reset();
+    }
+}
+
+exports.BatchBuilder = BatchBuilder;
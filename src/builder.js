@@ -1,14 +1,74 @@
 const { Buffer } = require("buffer");
 const { validateTableName, validateColumnName } = require("./util");
+const { native } = require("./native");
+const { spans, sampleRow, timed, traceSync } = require("./trace");
+
+const NEWLINE = 10;
+const CARRIAGE_RETURN = 13;
+const SPACE = 32;
+const QUOTE = 34;
+const COMMA = 44;
+const EQUALS = 61;
+const BACKSLASH = 92;
+const MINUS = 45;
+const DOT = 46;
+const ZERO = 48;
+const LETTER_F = 102;
+const LETTER_I = 105;
+const LETTER_T = 116;
+
+// binary format of protocol version 2, the value starts with '==' followed by the type
+const BINARY_DOUBLE = 16;
+const BINARY_ARRAY = 14;
+const ARRAY_ELEMENT_DOUBLE = 10;
+const MAX_ARRAY_DIMENSIONS = 32;
+
+const POWERS_OF_TEN = Array.from({ length: 16 }, (_, i) => 10 ** i);
+const MAX_FRACTION_DIGITS = 6;
+// shorter strings are escaped faster in JS than the cost of calling into the native encoder
+const NATIVE_MIN_LENGTH = 32;
+
+const MAX_SAFE_BIGINT = BigInt(Number.MAX_SAFE_INTEGER);
+const BIGINT_SPLIT_DIGITS = 15;
+const BIGINT_SPLIT = 10n ** BigInt(BIGINT_SPLIT_DIGITS);
+const MIN_FIXED_FLOAT = 0.000001;
+const MAX_FIXED_FLOAT = 1e15;
+
+// validated table and column names with their escaped utf8 bytes
+const MAX_CACHED_NAMES = 1024;
+const MAX_CACHED_SYMBOL_LENGTH = 256;
+const tableNames = new Map();
+const columnNames = new Map();
 
 class Builder {
-    constructor(bufferSize) {
+    // options:
+    //   maxBufferSize - the buffer doubles in size when it fills up, until it reaches maxBufferSize,
+    //                   defaults to bufferSize, which means the buffer does not grow
+    //   shared - if true, the buffer is backed by a SharedArrayBuffer, so it can be passed between threads
+    //   allocUnsafe - if true, the buffer is not zero-filled when allocated, only the bytes written are ever read
+    //   symbolCacheSize - number of symbol values kept with their escaped bytes, the least recently used one
+    //                     is evicted when the cache is full, 0 disables the cache, defaults to 0
+    //   protocolVersion - 1 writes floats as text, 2 writes them in binary and supports arrays,
+    //                     the server has to support version 2 too, defaults to 1
+    constructor(bufferSize, options = {}) {
+        this.maxBufferSize = options.maxBufferSize;
+        this.shared = !!options.shared;
+        this.allocUnsafe = !!options.allocUnsafe;
+        this.symbolCacheSize = options.symbolCacheSize || 0;
+        this.symbolCache = this.symbolCacheSize > 0 ? new Map() : null;
+        this.protocolVersion = options.protocolVersion || 1;
+        if (this.protocolVersion !== 1 && this.protocolVersion !== 2) {
+            throw `Unsupported protocol version: ${this.protocolVersion}`;
+        }
         this.resize(bufferSize);
     }
 
     resize(bufferSize) {
+        if (!this.maxBufferSize || this.maxBufferSize < bufferSize) {
+            this.maxBufferSize = bufferSize;
+        }
         this.bufferSize = bufferSize;
-        this.buffer = Buffer.alloc(this.bufferSize + 1, 0, 'utf8');
+        this.buffer = allocate(this, this.bufferSize);
         this.reset();
     }
 
@@ -18,6 +78,13 @@ class Builder {
         return this;
     }
 
+    // Discards the row being added, for example after one of its values failed validation.
+    // The rows closed by at() or atNow() are kept, the builder is ready for the next row.
+    rollback() {
+        rollback(this);
+        return this;
+    }
+
     addTable(table) {
         if (typeof table !== "string") {
             throw `Table name must be a string, received ${typeof table}`;
@@ -25,8 +92,7 @@ class Builder {
         if (this.hasTable) {
             throw "Table name has already been set";
         }
-        validateTableName(table);
-        writeEscaped(this, table);
+        writeName(this, table, tableNames, validateTableName);
         this.hasTable = true;
         return this;
     }
@@ -38,158 +104,824 @@ class Builder {
         if (!this.hasTable || this.hasColumns) {
             throw "Symbol can be added only after table name is set and before any column added";
         }
-        write(this, ',');
-        validateColumnName(name);
-        writeEscaped(this, name);
-        write(this, '=');
-        writeEscaped(this, value.toString());
+        writeChar(this, COMMA);
+        writeName(this, name, columnNames, validateColumnName);
+        writeChar(this, EQUALS);
+        writeSymbol(this, value.toString());
         this.hasSymbols = true;
         return this;
     }
 
     addString(name, value) {
-        addColumn(this, name, value, "string", false, () => {
-            write(this, '"');
-            writeEscaped(this, value, true);
-            write(this, '"');
-        });
+        addColumn(this, name, value, "string", false);
+        writeChar(this, QUOTE);
+        writeEscaped(this, value, true);
+        writeChar(this, QUOTE);
         return this;
     }
 
     addBoolean(name, value) {
-        addColumn(this, name, value, "boolean", false, () => {
-            write(this, value ? 't' : 'f');
-        });
+        addColumn(this, name, value, "boolean", false);
+        writeChar(this, value ? LETTER_T : LETTER_F);
         return this;
     }
 
     addFloat(name, value) {
-        addColumn(this, name, value, "number", false, () => {
-            write(this, value.toString());
-        });
+        addColumn(this, name, value, "number", false);
+        writeDouble(this, value);
+        return this;
+    }
+
+    // values is an array of numbers, a Float64Array, or nested arrays of the same length for more dimensions,
+    // for example [[1.1, 2.2], [3.3, 4.4]]. Requires protocol version 2.
+    addArray(name, values) {
+        const shape = arrayShape(this, values);
+        addColumn(this, name, values, "object", false);
+        writeArray(this, values, shape);
         return this;
     }
 
     addInteger(name, value) {
-        addColumn(this, name, value, "number", true, () => {
-            write(this, value.toString());
-            write(this, 'i');
-        });
+        addColumn(this, name, value, typeof value === "bigint" ? "bigint" : "number", true);
+        writeLong(this, value);
+        writeChar(this, LETTER_I);
         return this;
     }
 
+    // value is epoch microseconds, a number or a bigint
     addTimestamp(name, value) {
-        addColumn(this, name, value, "number", true, () => {
-            write(this, value.toString());
-            write(this, 't');
-        });
+        addColumn(this, name, value, typeof value === "bigint" ? "bigint" : "number", true);
+        writeLong(this, value);
+        writeChar(this, LETTER_T);
         return this;
     }
 
+    // timestamp is epoch nanoseconds, a number or a bigint,
+    // numbers above Number.MAX_SAFE_INTEGER lose precision, use a bigint or atMicros()/atMillis() instead
     at(timestamp) {
-        if (typeof timestamp !== "number") {
-            throw `Timestamp must be a number, received ${typeof timestamp}`;
-        }
-        if (!Number.isInteger(timestamp)) {
-            throw `Timestamp must be an integer, received ${timestamp}`;
-        }
-        if (!this.hasSymbols && !this.hasColumns) {
-            throw "The row must have a symbol or field set before it is closed";
-        }
-        write(this, ' ');
-        write(this, timestamp.toString());
-        write(this, '\n');
-        startNewRow(this);
+        closeRow(this, timestamp, 0);
+    }
+
+    atNanos(timestamp) {
+        closeRow(this, timestamp, 0);
+    }
+
+    atMicros(timestamp) {
+        closeRow(this, timestamp, 3);
+    }
+
+    atMillis(timestamp) {
+        closeRow(this, timestamp, 6);
     }
 
     atNow() {
         if (!this.hasSymbols && !this.hasColumns) {
             throw "The row must have a symbol or field set before it is closed";
         }
-        write(this, '\n');
+        writeChar(this, NEWLINE);
         startNewRow(this);
     }
 
+    // Compiles a row writer for a fixed schema, for example:
+    //   const write = builder.compile({ table: "trades", symbols: ["pair"], columns: { price: "float", amount: "integer" } });
+    //   write(["BTC-USD", 20654.3, 25], 1658484765000000000);
+    // The writer takes the values of the symbols followed by the values of the columns, and an optional
+    // designated timestamp. Column types: "string", "boolean", "float", "integer", "timestamp" and "array".
+    // The names are validated and escaped once, the types of the values are not checked by the writer.
+    compile(schema) {
+        return compileRowWriter(this, schema);
+    }
+
+    // Appends rows from column arrays in a single pass, for example:
+    //   builder.appendColumns("trades", {
+    //       symbols: { pair: ["BTC-USD", "ETH-USD"] },
+    //       columns: { price: new Float64Array([20654.3, 1541.2]), amount: { type: "integer", values: [25, 3] } },
+    //       timestamps: new BigInt64Array([1658484765000000000n, 1658484765000001000n])
+    //   });
+    // The column type is taken from the typed array, or from the first value of a plain array
+    // (number is float, bigint is integer, an array is an array column), or it can be set explicitly as above.
+    // timestamps are epoch nanos, without timestamps the rows are closed by atNow().
+    // null and undefined values in plain arrays are skipped.
+    // If a row is invalid, the rows before it are kept, the invalid one is discarded.
+    appendColumns(table, data) {
+        appendColumns(this, table, data);
+        return this;
+    }
+
     toBuffer() {
-        if (this.hasTable) {
-            throw "The builder's content is invalid, row needs to be closed by calling at() or atNow()";
-        }
-        if (this.position < 1) {
-            throw "The builder is empty";
-        }
-        return this.buffer.subarray(0, this.position);
+        return traceSync(spans.toBuffer, () => {
+            if (this.hasTable) {
+                throw "The builder's content is invalid, row needs to be closed by calling at() or atNow()";
+            }
+            if (this.position < 1) {
+                throw "The builder is empty";
+            }
+            return this.buffer.subarray(0, this.position);
+        }, { builder: this });
+    }
+}
+
+// the timestamp is multiplied by 10^numOfZeros by appending zeros to its digits
+function closeRow(builder, timestamp, numOfZeros) {
+    if (typeof timestamp !== "number" && typeof timestamp !== "bigint") {
+        throw `Timestamp must be a number or a bigint, received ${typeof timestamp}`;
+    }
+    if (typeof timestamp === "number" && !Number.isInteger(timestamp)) {
+        throw `Timestamp must be an integer, received ${timestamp}`;
+    }
+    if (!builder.hasSymbols && !builder.hasColumns) {
+        throw "The row must have a symbol or field set before it is closed";
     }
+    writeChar(builder, SPACE);
+    writeLong(builder, timestamp);
+    if (numOfZeros > 0 && timestamp !== 0 && timestamp !== 0n) {
+        writeDigits(builder, 0, numOfZeros);
+    }
+    writeChar(builder, NEWLINE);
+    startNewRow(builder);
 }
 
 function startNewRow(builder) {
+    // the phases of a sampled row are timed, see getPhaseTimings()
+    builder.sampled = sampleRow();
+    builder.rowStart = builder.position;
     builder.hasTable = false;
     builder.hasSymbols = false;
     builder.hasColumns = false;
 }
 
-function addColumn(builder, name, value, valueType, valueShouldBeInteger, writeValue) {
+// rowStart is moved to the end of each row when it is closed, so rolling back is only resetting the position
+function rollback(builder) {
+    builder.position = builder.rowStart;
+    startNewRow(builder);
+}
+
+function addColumn(builder, name, value, valueType, valueShouldBeInteger) {
     if (typeof name !== "string") {
         throw `Field name must be a string, received ${typeof name}`;
     }
     if (typeof value !== valueType) {
         throw `Field value must be a ${valueType}, received ${typeof value}`;
     }
-    if (valueShouldBeInteger && !Number.isInteger(value)) {
+    if (valueShouldBeInteger && valueType === "number" && !Number.isInteger(value)) {
         throw `Field value must be an integer, received ${value}`;
     }
     if (!builder.hasTable) {
         throw "Field can be added only after table name is set";
     }
-    write(builder, builder.hasColumns ? ',' : ' ');
-    validateColumnName(name);
-    writeEscaped(builder, name);
-    write(builder, '=');
-    writeValue();
+    writeChar(builder, builder.hasColumns ? COMMA : SPACE);
+    writeName(builder, name, columnNames, validateColumnName);
+    writeChar(builder, EQUALS);
     builder.hasColumns = true;
 }
 
+const VALUE_WRITERS = {
+    symbol: (builder, value) => writeSymbol(builder, value.toString()),
+    string: (builder, value) => writeEscaped(builder, value, true),
+    boolean: (builder, value) => writeChar(builder, value ? LETTER_T : LETTER_F),
+    float: writeDouble,
+    integer: writeLong,
+    timestamp: writeLong,
+    array: (builder, value) => writeArray(builder, value, arrayShape(builder, value))
+};
+
+const VALUE_SUFFIXES = {
+    symbol: '',
+    string: '"',
+    boolean: '',
+    float: '',
+    integer: 'i',
+    timestamp: 't',
+    array: ''
+};
+
+const TYPED_ARRAY_TYPES = new Map([
+    [Float64Array, "float"],
+    [Float32Array, "float"],
+    [BigInt64Array, "integer"],
+    [BigUint64Array, "integer"],
+    [Int32Array, "integer"],
+    [Uint32Array, "integer"],
+    [Int16Array, "integer"],
+    [Uint16Array, "integer"],
+    [Int8Array, "integer"],
+    [Uint8Array, "integer"]
+]);
+
+const PLAIN_VALUE_TYPES = {
+    string: "string",
+    boolean: "boolean",
+    number: "float",
+    bigint: "integer"
+};
+
+function appendColumns(builder, table, data) {
+    if (typeof table !== "string") {
+        throw `Table name must be a string, received ${typeof table}`;
+    }
+    if (builder.hasTable) {
+        throw "Table name has already been set";
+    }
+    const { symbols = {}, columns = {}, timestamps } = data;
+    const tableBytes = nameBytes(table, tableNames, validateTableName);
+
+    let numOfRows = -1;
+    const checkLength = (name, values) => {
+        if (!values || typeof values.length !== "number") {
+            throw `Values of ${name} must be an array`;
+        }
+        if (numOfRows > -1 && values.length !== numOfRows) {
+            throw `All columns must have the same number of values, ${name} has ${values.length} instead of ${numOfRows}`;
+        }
+        numOfRows = values.length;
+    };
+
+    const symbolNames = [];
+    const symbolValues = [];
+    for (const name of Object.keys(symbols)) {
+        checkLength(name, symbols[name]);
+        symbolNames.push(nameBytes(name, columnNames, validateColumnName));
+        symbolValues.push(symbols[name]);
+    }
+
+    const columnList = [];
+    for (const name of Object.keys(columns)) {
+        const column = columns[name];
+        const values = Array.isArray(column) || ArrayBuffer.isView(column) ? column : column.values;
+        checkLength(name, values);
+        const typed = ArrayBuffer.isView(values);
+        let type = values !== column && column.type ? column.type : TYPED_ARRAY_TYPES.get(values.constructor);
+        if (!type) {
+            const value = values.find(value => value !== null && value !== undefined);
+            if (value === undefined) {
+                // no values at all
+                continue;
+            }
+            type = Array.isArray(value) || value instanceof Float64Array ? "array" : PLAIN_VALUE_TYPES[typeof value];
+        }
+        if (!VALUE_WRITERS[type] || type === "symbol") {
+            throw `Unsupported column type: ${type}`;
+        }
+        const suffix = VALUE_SUFFIXES[type];
+        columnList.push({
+            name: nameBytes(name, columnNames, validateColumnName),
+            type: type,
+            values: values,
+            checked: typed,
+            quoted: type === "string",
+            suffix: suffix.length > 0 ? suffix.charCodeAt(0) : 0,
+            writeValue: VALUE_WRITERS[type]
+        });
+    }
+    if (timestamps !== undefined && timestamps !== null) {
+        checkLength("timestamps", timestamps);
+    }
+
+    for (let row = 0; row < numOfRows; row++) {
+        try {
+            writeBytes(builder, tableBytes);
+            builder.hasTable = true;
+            for (let i = 0; i < symbolNames.length; i++) {
+                const value = symbolValues[i][row];
+                if (value === null || value === undefined) {
+                    continue;
+                }
+                writeChar(builder, COMMA);
+                writeBytes(builder, symbolNames[i]);
+                writeChar(builder, EQUALS);
+                writeSymbol(builder, value.toString());
+                builder.hasSymbols = true;
+            }
+            for (let i = 0; i < columnList.length; i++) {
+                const column = columnList[i];
+                const value = column.values[row];
+                if (!column.checked) {
+                    if (value === null || value === undefined) {
+                        continue;
+                    }
+                    checkValue(column.type, value);
+                }
+                writeChar(builder, builder.hasColumns ? COMMA : SPACE);
+                writeBytes(builder, column.name);
+                writeChar(builder, EQUALS);
+                if (column.quoted) {
+                    writeChar(builder, QUOTE);
+                }
+                column.writeValue(builder, value);
+                if (column.suffix) {
+                    writeChar(builder, column.suffix);
+                }
+                builder.hasColumns = true;
+            }
+            if (timestamps === undefined || timestamps === null) {
+                builder.atNow();
+            } else {
+                builder.at(timestamps[row]);
+            }
+        } catch (e) {
+            rollback(builder);
+            throw e;
+        }
+    }
+}
+
+function checkValue(type, value) {
+    switch (type) {
+        case "string":
+        case "boolean":
+            if (typeof value !== type) {
+                throw `Field value must be a ${type}, received ${typeof value}`;
+            }
+            break;
+        case "float":
+            if (typeof value !== "number") {
+                throw `Field value must be a number, received ${typeof value}`;
+            }
+            break;
+        case "array":
+            // checked when the shape of the array is calculated
+            break;
+        default:
+            if (typeof value !== "bigint" && !Number.isInteger(value)) {
+                throw `Field value must be an integer, received ${value}`;
+            }
+            break;
+    }
+}
+
+function compileRowWriter(builder, schema) {
+    const { table, symbols = [], columns = {} } = schema;
+    if (typeof table !== "string") {
+        throw `Table name must be a string, received ${typeof table}`;
+    }
+    validateTableName(table);
+
+    const fields = symbols.map(name => ({ name: name, type: "symbol" }));
+    for (const name of Object.keys(columns)) {
+        if (!VALUE_WRITERS[columns[name]] || columns[name] === "symbol") {
+            throw `Unsupported column type: ${columns[name]}`;
+        }
+        fields.push({ name: name, type: columns[name] });
+    }
+    if (fields.length < 1) {
+        throw "The schema must have a symbol or field";
+    }
+
+    // the constant parts between the values: separators, names, and the type suffix of the previous value
+    const scratch = new Builder(1024, { maxBufferSize: 1048576 });
+    const segments = [];
+    const writers = [];
+    let suffix = '';
+    writeEscaped(scratch, table);
+    for (let i = 0; i < fields.length; i++) {
+        const { name, type } = fields[i];
+        if (typeof name !== "string") {
+            throw `Field name must be a string, received ${typeof name}`;
+        }
+        validateColumnName(name);
+        write(scratch, suffix);
+        write(scratch, type === "symbol" || (i > 0 && fields[i - 1].type !== "symbol") ? ',' : ' ');
+        writeEscaped(scratch, name);
+        write(scratch, type === "string" ? '="' : '=');
+        segments.push(Buffer.from(scratch.toBuffer()));
+        scratch.reset();
+        writers.push(VALUE_WRITERS[type]);
+        suffix = VALUE_SUFFIXES[type];
+    }
+    const rowEnd = Buffer.from(`${suffix}\n`);
+    const timestampStart = Buffer.from(`${suffix} `);
+    const numOfFields = fields.length;
+
+    return (values, timestamp) => {
+        if (builder.hasTable) {
+            throw "Table name has already been set";
+        }
+        try {
+            for (let i = 0; i < numOfFields; i++) {
+                writeBytes(builder, segments[i]);
+                writers[i](builder, values[i]);
+            }
+            if (timestamp === undefined) {
+                writeBytes(builder, rowEnd);
+            } else {
+                writeBytes(builder, timestampStart);
+                writeLong(builder, timestamp);
+                writeChar(builder, NEWLINE);
+            }
+        } catch (e) {
+            // the partially written row is discarded, the rows written before are kept
+            rollback(builder);
+            throw e;
+        }
+        startNewRow(builder);
+    };
+}
+
 function write(builder, data) {
-    builder.position += builder.buffer.write(data, builder.position);
+    const position = builder.position;
+    const written = builder.buffer.write(data, position);
+    builder.position += written;
+    if (builder.position <= builder.bufferSize && builder.bufferSize - builder.position < 3
+        && written !== Buffer.byteLength(data)) {
+        // Buffer.write() does not split multibyte characters, a truncated write can stop short of the last byte
+        builder.position += Buffer.byteLength(data) - written;
+    }
     if (builder.position > builder.bufferSize) {
-        throw `Buffer overflow [position=${builder.position}, bufferSize=${builder.bufferSize}]`;
+        const required = position + Buffer.byteLength(data);
+        if (required > builder.maxBufferSize) {
+            overflow(builder);
+        }
+        builder.position = position;
+        grow(builder, required);
+        builder.position += builder.buffer.write(data, position);
+    }
+}
+
+function reserve(builder, length) {
+    const required = builder.position + length;
+    if (required > builder.bufferSize) {
+        if (required > builder.maxBufferSize) {
+            // report the position the same way as a write truncated at the end of the buffer
+            builder.position = Math.min(required, builder.bufferSize + 1);
+            overflow(builder);
+        }
+        grow(builder, required);
+    }
+}
+
+function writeBytes(builder, bytes) {
+    reserve(builder, bytes.length);
+    builder.position += bytes.copy(builder.buffer, builder.position);
+}
+
+function writeChar(builder, code) {
+    reserve(builder, 1);
+    builder.buffer[builder.position++] = code;
+}
+
+// Writes the digits of the integer directly into the buffer, without converting it to a string first.
+// Integers outside of the safe range are formatted by toString(), the same way as before.
+function writeInteger(builder, value) {
+    if (value < 0) {
+        if (value < -Number.MAX_SAFE_INTEGER) {
+            write(builder, value.toString());
+            return;
+        }
+        writeChar(builder, MINUS);
+        value = -value;
+    } else if (value > Number.MAX_SAFE_INTEGER) {
+        write(builder, value.toString());
+        return;
+    }
+    writeDigits(builder, value, numOfDigits(value));
+}
+
+// Decimals with at most 15 significant digits and 6 fraction digits are written digit by digit.
+// If m / 10^k reproduces the value for the smallest k, m is the same unique shortest representation
+// toString() would produce, other values are formatted by toString().
+function writeFloat(builder, value) {
+    if (Number.isInteger(value)) {
+        writeInteger(builder, value);
+        return;
+    }
+    const absolute = Math.abs(value);
+    if (absolute < MIN_FIXED_FLOAT || absolute >= MAX_FIXED_FLOAT) {
+        write(builder, value.toString());
+        return;
+    }
+    for (let fractionDigits = 1; fractionDigits <= MAX_FRACTION_DIGITS; fractionDigits++) {
+        const power = POWERS_OF_TEN[fractionDigits];
+        const mantissa = Math.round(absolute * power);
+        if (mantissa >= MAX_FIXED_FLOAT) {
+            break;
+        }
+        if (mantissa / power === absolute) {
+            if (value < 0) {
+                writeChar(builder, MINUS);
+            }
+            const integer = Math.floor(mantissa / power);
+            writeDigits(builder, integer, numOfDigits(integer));
+            writeChar(builder, DOT);
+            writeDigits(builder, mantissa - integer * power, fractionDigits);
+            return;
+        }
+    }
+    write(builder, value.toString());
+}
+
+function writeDouble(builder, value) {
+    if (builder.sampled) {
+        timed("numbers", formatDouble, builder, value);
+        return;
+    }
+    formatDouble(builder, value);
+}
+
+function formatDouble(builder, value) {
+    if (builder.protocolVersion > 1) {
+        // the first '=' has been written already
+        reserve(builder, 10);
+        builder.buffer[builder.position++] = EQUALS;
+        builder.buffer[builder.position++] = BINARY_DOUBLE;
+        builder.position = builder.buffer.writeDoubleLE(value, builder.position);
+    } else {
+        writeFloat(builder, value);
+    }
+}
+
+// returns the length of each dimension, the array has to be rectangular and the elements have to be numbers
+function arrayShape(builder, values) {
+    if (builder.protocolVersion < 2) {
+        throw "Arrays are supported only with protocol version 2";
+    }
+    if (values instanceof Float64Array) {
+        return [values.length];
+    }
+    if (!Array.isArray(values)) {
+        throw `Array value must be an array or a Float64Array, received ${typeof values}`;
+    }
+    const shape = [];
+    let level = values;
+    while (Array.isArray(level)) {
+        shape.push(level.length);
+        if (shape.length > MAX_ARRAY_DIMENSIONS) {
+            throw `Array cannot have more than ${MAX_ARRAY_DIMENSIONS} dimensions`;
+        }
+        level = level[0];
+    }
+    checkArray(values, shape, 0);
+    return shape;
+}
+
+function checkArray(values, shape, dimension) {
+    if (!Array.isArray(values) || values.length !== shape[dimension]) {
+        throw `Array must be rectangular, dimension ${dimension} should have ${shape[dimension]} elements`;
+    }
+    for (let i = 0; i < values.length; i++) {
+        if (dimension < shape.length - 1) {
+            checkArray(values[i], shape, dimension + 1);
+        } else if (typeof values[i] !== "number") {
+            throw `Array elements must be numbers, received ${Array.isArray(values[i]) ? "array" : typeof values[i]}`;
+        }
+    }
+}
+
+// '=' ARRAY DOUBLE <number of dimensions> <length of each dimension as int32> <elements as float64>, little endian,
+// the first '=' has been written already
+function writeArray(builder, values, shape) {
+    let numOfElements = 1;
+    for (const length of shape) {
+        numOfElements *= length;
+    }
+    reserve(builder, 4 + shape.length * 4 + numOfElements * 8);
+    const buffer = builder.buffer;
+    buffer[builder.position++] = EQUALS;
+    buffer[builder.position++] = BINARY_ARRAY;
+    buffer[builder.position++] = ARRAY_ELEMENT_DOUBLE;
+    buffer[builder.position++] = shape.length;
+    for (const length of shape) {
+        builder.position = buffer.writeInt32LE(length, builder.position);
+    }
+    writeArrayElements(builder, values, shape.length);
+}
+
+function writeArrayElements(builder, values, numOfDimensions) {
+    if (numOfDimensions > 1) {
+        for (let i = 0; i < values.length; i++) {
+            writeArrayElements(builder, values[i], numOfDimensions - 1);
+        }
+        return;
+    }
+    const buffer = builder.buffer;
+    for (let i = 0; i < values.length; i++) {
+        builder.position = buffer.writeDoubleLE(values[i], builder.position);
+    }
+}
+
+function writeLong(builder, value) {
+    if (builder.sampled) {
+        timed("numbers", formatLong, builder, value);
+        return;
+    }
+    formatLong(builder, value);
+}
+
+function formatLong(builder, value) {
+    if (typeof value === "bigint") {
+        writeBigInt(builder, value);
+    } else {
+        writeInteger(builder, value);
+    }
+}
+
+// The bigint is split into two safe integers, the digits of those are written into the buffer.
+function writeBigInt(builder, value) {
+    if (value < 0n) {
+        writeChar(builder, MINUS);
+        value = -value;
     }
+    if (value <= MAX_SAFE_BIGINT) {
+        const number = Number(value);
+        writeDigits(builder, number, numOfDigits(number));
+        return;
+    }
+    const high = value / BIGINT_SPLIT;
+    if (high > MAX_SAFE_BIGINT) {
+        write(builder, value.toString());
+        return;
+    }
+    const highNumber = Number(high);
+    writeDigits(builder, highNumber, numOfDigits(highNumber));
+    writeDigits(builder, Number(value - high * BIGINT_SPLIT), BIGINT_SPLIT_DIGITS);
+}
+
+// writes the lowest numOfDigits digits of a non-negative safe integer, padded with zeros
+function writeDigits(builder, value, numOfDigits) {
+    reserve(builder, numOfDigits);
+    const buffer = builder.buffer;
+    let position = builder.position + numOfDigits;
+    builder.position = position;
+    for (let i = 0; i < numOfDigits; i++) {
+        const quotient = Math.floor(value / 10);
+        buffer[--position] = ZERO + (value - quotient * 10);
+        value = quotient;
+    }
+}
+
+function numOfDigits(value) {
+    let digits = 1;
+    while (digits < POWERS_OF_TEN.length && value >= POWERS_OF_TEN[digits]) {
+        digits++;
+    }
+    return digits;
+}
+
+// returns the escaped utf8 bytes of the name, from the cache if possible
+function nameBytes(name, cache, validate) {
+    let bytes = cache.get(name);
+    if (bytes === undefined) {
+        if (typeof name !== "string") {
+            throw `Field name must be a string, received ${typeof name}`;
+        }
+        validate(name);
+        const scratch = new Builder(name.length * 4);
+        writeEscaped(scratch, name);
+        bytes = Buffer.from(scratch.buffer.subarray(0, scratch.position));
+        if (cache.size < MAX_CACHED_NAMES) {
+            cache.set(name, bytes);
+        }
+    }
+    return bytes;
+}
+
+function writeName(builder, name, cache, validate) {
+    const bytes = cache.get(name);
+    if (bytes !== undefined) {
+        writeBytes(builder, bytes);
+        return;
+    }
+    if (builder.sampled) {
+        timed("validation", validate, name);
+    } else {
+        validate(name);
+    }
+    const start = builder.position;
+    writeEscaped(builder, name);
+    if (cache.size < MAX_CACHED_NAMES) {
+        cache.set(name, Buffer.from(builder.buffer.subarray(start, builder.position)));
+    }
+}
+
+function writeSymbol(builder, value) {
+    const cache = builder.symbolCache;
+    if (cache === null || value.length > MAX_CACHED_SYMBOL_LENGTH) {
+        writeEscaped(builder, value);
+        return;
+    }
+    const bytes = cache.get(value);
+    if (bytes !== undefined) {
+        // the Map iterates in insertion order, inserting the value again makes it the most recently used one
+        cache.delete(value);
+        cache.set(value, bytes);
+        writeBytes(builder, bytes);
+        return;
+    }
+    const start = builder.position;
+    writeEscaped(builder, value);
+    if (cache.size >= builder.symbolCacheSize) {
+        cache.delete(cache.keys().next().value);
+    }
+    cache.set(value, Buffer.from(builder.buffer.subarray(start, builder.position)));
+}
+
+function grow(builder, required) {
+    let bufferSize = Math.max(builder.bufferSize, 1);
+    while (bufferSize < required) {
+        bufferSize *= 2;
+    }
+    bufferSize = Math.min(bufferSize, builder.maxBufferSize);
+
+    const buffer = allocate(builder, bufferSize);
+    builder.buffer.copy(buffer, 0, 0, builder.position);
+    builder.buffer = buffer;
+    builder.bufferSize = bufferSize;
+}
+
+function allocate(builder, bufferSize) {
+    if (builder.shared) {
+        return Buffer.from(new SharedArrayBuffer(bufferSize + 1));
+    }
+    if (builder.allocUnsafe) {
+        return Buffer.allocUnsafe(bufferSize + 1);
+    }
+    return Buffer.alloc(bufferSize + 1, 0, 'utf8');
+}
+
+function overflow(builder) {
+    const message = `Buffer overflow [position=${builder.position}, bufferSize=${builder.bufferSize}]`;
+    // discard the incomplete row, the rows already closed by at() or atNow() are kept
+    rollback(builder);
+    throw message;
 }
 
 function writeEscaped(builder, data, quoted = false) {
-    for (let ch of data) {
-        if (ch > '\\') {
-            write(builder, ch);
+    if (builder.sampled) {
+        timed("escaping", escapeText, builder, data, quoted);
+        return;
+    }
+    escapeText(builder, data, quoted);
+}
+
+function escapeText(builder, data, quoted) {
+    const length = data.length;
+    if (native && length >= NATIVE_MIN_LENGTH) {
+        const position = native.writeEscaped(builder.buffer, builder.position, builder.bufferSize, data, length, quoted);
+        if (position > -1) {
+            builder.position = position;
+            return;
+        }
+        // does not fit, the JS implementation grows the buffer or reports the overflow
+    }
+    let start = 0;
+    let ascii = true;
+    for (let i = 0; i < length; i++) {
+        const code = data.charCodeAt(i);
+        if (code > BACKSLASH) {
+            if (code > 0x7f) {
+                ascii = false;
+            }
             continue;
         }
 
-        switch (ch) {
-            case ' ':
-            case ',':
-            case '=':
-                if (!quoted) {
-                    write(builder, '\\');
-                }
-                write(builder, ch);
+        let escape;
+        switch (code) {
+            case SPACE:
+            case COMMA:
+            case EQUALS:
+                escape = !quoted;
                 break;
-            case '\n':
-            case '\r':
-                write(builder, '\\');
-                write(builder, ch);
+            case NEWLINE:
+            case CARRIAGE_RETURN:
+            case BACKSLASH:
+                escape = true;
                 break;
-            case '"':
-                if (quoted) {
-                    write(builder, '\\');
-                }
-                write(builder, ch);
-                break;
-            case '\\':
-                write(builder, '\\\\');
+            case QUOTE:
+                escape = quoted;
                 break;
             default:
-                write(builder, ch);
+                escape = false;
                 break;
         }
+        if (escape) {
+            // the escaped character is written as the first character of the next run
+            writeRun(builder, data, start, i, ascii);
+            write(builder, '\\');
+            start = i;
+            ascii = true;
+        }
+    }
+    writeRun(builder, data, start, length, ascii);
+}
+
+function writeRun(builder, data, start, end, ascii) {
+    const length = end - start;
+    if (length < 1) {
+        return;
+    }
+    if (!ascii || builder.position + length > builder.bufferSize) {
+        write(builder, length === data.length ? data : data.substring(start, end));
+        return;
+    }
+    if (length === data.length) {
+        builder.position += builder.buffer.write(data, builder.position, length, 'latin1');
+        return;
+    }
+    const buffer = builder.buffer;
+    let position = builder.position;
+    for (let i = start; i < end; i++) {
+        buffer[position++] = data.charCodeAt(i);
     }
+    builder.position = position;
 }
 
 exports.Builder = Builder;
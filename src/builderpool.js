@@ -0,0 +1,47 @@
+const { Builder } = require("./builder");
+
+const DEFAULT_MAX_POOLED = 16;
+
+// Hands out reset builders, so services building a batch per request do not allocate a buffer each time.
+// The buffers are allocated uninitialized, without zero-filling them, and reused once the builder is released.
+//   const builder = pool.acquire();
+//   builder.addTable("trades").addSymbol("pair", "BTC-USD").addFloat("price", 20654.3).atNow();
+//   await pool.send(sender, builder);
+class BuilderPool {
+    // options:
+    //   maxPooled - max number of builders kept in the pool, the rest is left to the gc, defaults to 16
+    //   any other option is passed to Builder
+    constructor(bufferSize, options = {}) {
+        this.bufferSize = bufferSize;
+        this.maxPooled = options.maxPooled || DEFAULT_MAX_POOLED;
+        this.options = { ...options, allocUnsafe: true };
+        this.builders = [];
+    }
+
+    get size() {
+        return this.builders.length;
+    }
+
+    acquire() {
+        const builder = this.builders.pop();
+        return builder ? builder : new Builder(this.bufferSize, this.options);
+    }
+
+    // the builder must not be used after it has been released
+    release(builder) {
+        if (this.builders.length < this.maxPooled && !this.builders.includes(builder)) {
+            this.builders.push(builder.reset());
+        }
+    }
+
+    // Sends the content of the builder via the sender, the builder is released when the write completed.
+    // If the send fails, or a row is still open, the builder is left with the caller with its rows,
+    // so the batch can be retried, the caller releases it when done.
+    async send(sender, builder) {
+        const data = builder.toBuffer();
+        await sender.send(data);
+        this.release(builder);
+    }
+}
+
+exports.BuilderPool = BuilderPool;
@@ -0,0 +1,245 @@
+const http = require("http");
+const https = require("https");
+const zlib = require("zlib");
+const { Buffer } = require("buffer");
+const { RowSender, clearFlushTimer, createBuilder } = require("./rowsender");
+
+const DEFAULT_AUTO_FLUSH_ROWS = 75000;
+const DEFAULT_MAX_CONCURRENT_REQUESTS = 2;
+const DEFAULT_GZIP_MIN_SIZE = 65536; // 64 KB
+const DEFAULT_REQUEST_TIMEOUT = 10000; // 10 sec
+const WRITE_PATH = "/write?precision=n";
+const SETTINGS_PATH = "/settings";
+const PROTOCOL_VERSIONS_SETTING = "line.proto.support.versions";
+
+// Sends rows to the /write endpoint of the server over HTTP.
+// Each batch is a POST request which succeeds only if the server accepted all rows of the batch,
+// a rejected batch fails the flush with the error returned by the server.
+// The connections are kept alive and reused, up to maxConcurrentRequests batches are in flight at the same time.
+class HttpSender extends RowSender {
+    // options:
+    //   bufferSize, maxBufferSize - initial and max size of the buffer rows are collected in
+    //   symbolCacheSize - number of symbol values cached with their escaped bytes by each buffer, see Builder
+    //   protocolVersion - 1, 2 or "auto", 2 sends floats in binary and supports arrays, see Builder,
+    //                     with "auto" connect() asks the server which versions it supports, defaults to 1
+    //   autoFlush - if true, buffered rows are sent when any of the below thresholds is reached
+    //   autoFlushRows - number of rows, defaults to 75000
+    //   autoFlushBytes - size of the buffered rows in bytes, not set by default
+    //   autoFlushInterval - milliseconds elapsed since the first row of the batch was added, defaults to 1000
+    //   maxConcurrentRequests - number of batches sent in parallel, defaults to 2
+    //   gzip - if true, batches of gzipMinSize bytes or larger are compressed and uploaded chunked
+    //   gzipMinSize - defaults to 64 KB
+    //   requestTimeout - milliseconds to wait for the response, defaults to 10 sec
+    //   tls - if true, https is used, tlsOptions are passed to the https agent
+    //   token - sent as a bearer token, or username and password for basic authentication
+    constructor(options = {}) {
+        const negotiateProtocolVersion = options.protocolVersion === "auto";
+        // version 1 is used until the server reported the versions it supports
+        super(negotiateProtocolVersion ? { ...options, protocolVersion: 1 } : options, DEFAULT_AUTO_FLUSH_ROWS);
+        this.negotiateProtocolVersion = negotiateProtocolVersion;
+        this.maxConcurrentRequests = options.maxConcurrentRequests || DEFAULT_MAX_CONCURRENT_REQUESTS;
+        this.gzip = !!options.gzip;
+        this.gzipMinSize = options.gzipMinSize === undefined ? DEFAULT_GZIP_MIN_SIZE : options.gzipMinSize;
+        this.requestTimeout = options.requestTimeout || DEFAULT_REQUEST_TIMEOUT;
+        this.transport = options.tls ? https : http;
+        this.agent = new this.transport.Agent({
+            ...options.tlsOptions,
+            keepAlive: true,
+            maxSockets: this.maxConcurrentRequests
+        });
+        this.authorization = authorization(options);
+        this.requests = new Set();
+        this.errors = [];
+    }
+
+    // the connections are opened when the first batch is sent, or when the protocol version is negotiated
+    async connect(port, host) {
+        this.port = port;
+        this.host = host;
+        if (this.negotiateProtocolVersion) {
+            const versions = await supportedProtocolVersions(this);
+            this.protocolVersion = versions.includes(2) ? 2 : 1;
+            if (this.pendingRows < 1) {
+                this.builder = createBuilder(this);
+            }
+        }
+        return true;
+    }
+
+    async close() {
+        try {
+            await this.flush();
+        } finally {
+            this.agent.destroy();
+        }
+    }
+
+    // Sends the buffered rows, resolves when the server acknowledged all batches sent so far.
+    // Fails with the error of the first rejected batch since the last flush.
+    async flush() {
+        await startFlush(this);
+        await Promise.allSettled(this.requests);
+        if (this.errors.length > 0) {
+            const errors = this.errors;
+            this.errors = [];
+            throw errors[0];
+        }
+    }
+
+    // sends a batch, resolves when the server acknowledged it
+    async send(data) {
+        await waitForRequestSlot(this);
+        await post(this, data);
+    }
+
+    // Sends multiple batches, e.g. the buffers of several builders, in a single request.
+    // The server accepts or rejects the rows of all batches together.
+    async sendMany(buffers) {
+        if (buffers.length === 1) {
+            return this.send(buffers[0]);
+        }
+        return this.send(Buffer.concat(buffers.map(data => typeof data === "string" ? Buffer.from(data) : data)));
+    }
+
+    startFlush() {
+        return startFlush(this);
+    }
+}
+
+// Swaps the builder and starts sending its rows without waiting for the response,
+// the builder is reused after the request completed. A failed request is reported by the next flush.
+async function startFlush(sender) {
+    clearFlushTimer(sender);
+    if (sender.pendingRows < 1) {
+        return;
+    }
+    const builder = sender.builder;
+    // throws if a row is being added, the buffered rows are kept in the builder
+    const data = builder.toBuffer();
+    sender.builder = sender.spareBuilders.pop() || createBuilder(sender);
+    sender.pendingRows = 0;
+
+    await waitForRequestSlot(sender);
+    post(sender, data)
+        .catch(err => sender.errors.push(err))
+        .finally(() => {
+            builder.reset();
+            if (sender.spareBuilders.length < sender.maxConcurrentRequests) {
+                sender.spareBuilders.push(builder);
+            }
+        });
+}
+
+async function waitForRequestSlot(sender) {
+    while (sender.requests.size >= sender.maxConcurrentRequests) {
+        await Promise.race(sender.requests);
+    }
+}
+
+function post(sender, data) {
+    const request = new Promise((resolve, reject) => {
+        const compress = sender.gzip && data.length >= sender.gzipMinSize;
+        const headers = { "Content-Type": "text/plain; charset=utf-8" };
+        if (compress) {
+            headers["Content-Encoding"] = "gzip";
+        } else {
+            headers["Content-Length"] = Buffer.byteLength(data);
+        }
+        if (sender.authorization) {
+            headers["Authorization"] = sender.authorization;
+        }
+
+        const req = sender.transport.request({
+            host: sender.host,
+            port: sender.port,
+            path: WRITE_PATH,
+            method: "POST",
+            agent: sender.agent,
+            headers: headers,
+            timeout: sender.requestTimeout
+        }, res => {
+            const chunks = [];
+            res.on("data", chunk => chunks.push(chunk));
+            res.on("end", () => {
+                if (res.statusCode >= 200 && res.statusCode < 300) {
+                    resolve();
+                    return;
+                }
+                reject(`HTTP request failed [status=${res.statusCode}, message=${errorMessage(Buffer.concat(chunks))}]`);
+            });
+            res.on("error", err => reject(`HTTP request failed [error=${err.message}]`));
+        });
+        req.on("timeout", () => req.destroy(new Error(`no response in ${sender.requestTimeout} ms`)));
+        req.on("error", err => reject(`HTTP request failed [error=${err.message}]`));
+
+        if (compress) {
+            // without Content-Length the compressed batch is uploaded with chunked transfer encoding
+            const gzip = zlib.createGzip();
+            gzip.on("error", err => req.destroy(err));
+            gzip.pipe(req);
+            gzip.end(data);
+        } else {
+            req.end(data);
+        }
+    });
+
+    const settled = request.then(() => {}, () => {}).finally(() => sender.requests.delete(settled));
+    sender.requests.add(settled);
+    return request;
+}
+
+// Asks the server for the protocol versions it supports, servers not reporting them support only version 1.
+function supportedProtocolVersions(sender) {
+    return new Promise(resolve => {
+        const headers = sender.authorization ? { "Authorization": sender.authorization } : {};
+        const req = sender.transport.get({
+            host: sender.host,
+            port: sender.port,
+            path: SETTINGS_PATH,
+            agent: sender.agent,
+            headers: headers,
+            timeout: sender.requestTimeout
+        }, res => {
+            const chunks = [];
+            res.on("data", chunk => chunks.push(chunk));
+            res.on("end", () => {
+                try {
+                    const settings = JSON.parse(Buffer.concat(chunks).toString());
+                    const versions = settings.config && settings.config[PROTOCOL_VERSIONS_SETTING];
+                    resolve(res.statusCode === 200 && Array.isArray(versions) ? versions : [1]);
+                } catch (e) {
+                    resolve([1]);
+                }
+            });
+            res.on("error", () => resolve([1]));
+        });
+        req.on("timeout", () => req.destroy());
+        req.on("error", () => resolve([1]));
+    });
+}
+
+// the server returns the error as json, the message is taken from it if it can be parsed
+function errorMessage(body) {
+    const text = body.toString();
+    try {
+        const error = JSON.parse(text);
+        if (error && error.message) {
+            return error.line ? `${error.message}, line ${error.line}` : error.message;
+        }
+    } catch (e) {
+        // not json
+    }
+    return text;
+}
+
+function authorization(options) {
+    if (options.token) {
+        return `Bearer ${options.token}`;
+    }
+    if (options.username) {
+        return `Basic ${Buffer.from(`${options.username}:${options.password || ""}`).toString("base64")}`;
+    }
+    return null;
+}
+
+exports.HttpSender = HttpSender;
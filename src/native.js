@@ -0,0 +1,19 @@
+// Loads the optional native encoder from the node-gyp build directory, it is built by npm run build:native.
+// null is exported if it is not available, or if it is disabled by setting QUESTDB_NATIVE=0.
+const path = require("path");
+
+const ADDON_PATH = path.join(__dirname, "..", "build", "Release", "questdb_encoder.node");
+
+function load() {
+    if (process.env.QUESTDB_NATIVE === "0") {
+        return null;
+    }
+    try {
+        return require(ADDON_PATH);
+    } catch (e) {
+        // not built, the JavaScript encoder is used
+        return null;
+    }
+}
+
+exports.native = load();
@@ -0,0 +1,187 @@
+// Optional native encoder used by the Builder, see src/native.js.
+// Built by 'npm run build:native', it is not built when the package is installed (gypfile is false in package.json),
+// the JS implementation is used if the addon is not available.
+
+#ifndef NAPI_VERSION
+#define NAPI_VERSION 6
+#endif
+
+#include <node_api.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define QUESTDB_SSE2 1
+#endif
+
+typedef struct {
+    char *data;
+    size_t size;
+} scratch_t;
+
+static int needs_escape(unsigned char ch, int quoted) {
+    switch (ch) {
+        case ' ':
+        case ',':
+        case '=':
+            return !quoted;
+        case '"':
+            return quoted;
+        case '\n':
+        case '\r':
+        case '\\':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// returns the index of the first character which needs escaping, or length if there is none
+static size_t find_escape(const unsigned char *src, size_t length, int quoted) {
+    size_t i = 0;
+#ifdef QUESTDB_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i equals = _mm_set1_epi8('=');
+    for (; i + 16 <= length; i += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i match = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage_return)),
+                _mm_cmpeq_epi8(chunk, backslash)
+        );
+        if (quoted) {
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, quote));
+        } else {
+            match = _mm_or_si128(
+                    match,
+                    _mm_or_si128(
+                            _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, comma)),
+                            _mm_cmpeq_epi8(chunk, equals)
+                    )
+            );
+        }
+        const int mask = _mm_movemask_epi8(match);
+        if (mask != 0) {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, (unsigned long) mask);
+            return i + index;
+#else
+            return i + (size_t) __builtin_ctz((unsigned int) mask);
+#endif
+        }
+    }
+#endif
+    for (; i < length; i++) {
+        if (needs_escape(src[i], quoted)) {
+            return i;
+        }
+    }
+    return length;
+}
+
+static void delete_scratch(napi_env env, void *data, void *hint) {
+    scratch_t *scratch = (scratch_t *) data;
+    free(scratch->data);
+    free(scratch);
+}
+
+// writeEscaped(buffer, position, limit, string, length, quoted)
+// Writes the escaped utf8 bytes of the string into the buffer starting at position.
+// Returns the new position, or -1 if the escaped string would end beyond limit, in which
+// case the caller falls back to the JS implementation which grows the buffer or reports the overflow.
+static napi_value write_escaped(napi_env env, napi_callback_info info) {
+    size_t argc = 6;
+    napi_value argv[6];
+    napi_value result;
+    if (napi_get_cb_info(env, info, &argc, argv, NULL, NULL) != napi_ok || argc < 6) {
+        napi_throw_error(env, NULL, "writeEscaped() expects 6 arguments");
+        return NULL;
+    }
+
+    uint8_t *buffer;
+    size_t buffer_length;
+    uint32_t position, limit, length;
+    bool quoted;
+    if (napi_get_buffer_info(env, argv[0], (void **) &buffer, &buffer_length) != napi_ok
+        || napi_get_value_uint32(env, argv[1], &position) != napi_ok
+        || napi_get_value_uint32(env, argv[2], &limit) != napi_ok
+        || napi_get_value_uint32(env, argv[4], &length) != napi_ok
+        || napi_get_value_bool(env, argv[5], &quoted) != napi_ok) {
+        napi_throw_type_error(env, NULL, "Invalid arguments");
+        return NULL;
+    }
+    if (limit > buffer_length) {
+        limit = (uint32_t) buffer_length;
+    }
+
+    scratch_t *scratch;
+    if (napi_get_instance_data(env, (void **) &scratch) != napi_ok || scratch == NULL) {
+        napi_throw_error(env, NULL, "Encoder is not initialized");
+        return NULL;
+    }
+    // a UTF-16 code unit is encoded in at most 3 bytes
+    const size_t required = (size_t) length * 3 + 1;
+    if (scratch->size < required) {
+        char *data = realloc(scratch->data, required);
+        if (data == NULL) {
+            napi_throw_error(env, NULL, "Out of memory");
+            return NULL;
+        }
+        scratch->data = data;
+        scratch->size = required;
+    }
+    size_t utf8_length;
+    if (napi_get_value_string_utf8(env, argv[3], scratch->data, scratch->size, &utf8_length) != napi_ok) {
+        napi_throw_type_error(env, NULL, "String expected");
+        return NULL;
+    }
+
+    const unsigned char *src = (const unsigned char *) scratch->data;
+    size_t out = position;
+    size_t i = 0;
+    while (i < utf8_length) {
+        const size_t next = i + find_escape(src + i, utf8_length - i, quoted);
+        const size_t run = next - i;
+        if (out + run > limit) {
+            napi_create_int32(env, -1, &result);
+            return result;
+        }
+        memcpy(buffer + out, src + i, run);
+        out += run;
+        i = next;
+        if (i < utf8_length) {
+            if (out + 2 > limit) {
+                napi_create_int32(env, -1, &result);
+                return result;
+            }
+            buffer[out++] = '\\';
+            buffer[out++] = src[i++];
+        }
+    }
+
+    napi_create_uint32(env, (uint32_t) out, &result);
+    return result;
+}
+
+NAPI_MODULE_INIT() {
+    scratch_t *scratch = calloc(1, sizeof(scratch_t));
+    if (scratch == NULL || napi_set_instance_data(env, scratch, delete_scratch, NULL) != napi_ok) {
+        free(scratch);
+        napi_throw_error(env, NULL, "Could not initialize the encoder");
+        return NULL;
+    }
+
+    napi_value fn;
+    if (napi_create_function(env, "writeEscaped", NAPI_AUTO_LENGTH, write_escaped, NULL, &fn) != napi_ok
+        || napi_set_named_property(env, exports, "writeEscaped", fn) != napi_ok) {
+        return NULL;
+    }
+    return exports;
+}
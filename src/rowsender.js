@@ -0,0 +1,158 @@
+const { EventEmitter } = require("events");
+const { Builder } = require("./builder");
+
+const DEFAULT_BUFFER_SIZE = 65536; // 64 KB
+const DEFAULT_MAX_BUFFER_SIZE = 104857600; // 100 MB
+const DEFAULT_AUTO_FLUSH_INTERVAL = 1000; // 1 sec
+
+// Row buffering shared by the transports, Sender and HttpSender.
+// Rows are collected in a builder, and the transport's startFlush() swaps it and sends its rows
+// when flush() is called, or when any of the auto flush thresholds is reached.
+class RowSender extends EventEmitter {
+    // options:
+    //   bufferSize, maxBufferSize - initial and max size of the buffer rows are collected in
+    //   symbolCacheSize - number of symbol values cached with their escaped bytes by each buffer, see Builder
+    //   protocolVersion - 1 or 2, see Builder
+    //   autoFlush - if true, buffered rows are sent when any of the below thresholds is reached
+    //   autoFlushRows - number of rows, the default is set by the transport
+    //   autoFlushBytes - size of the buffered rows in bytes, not set by default
+    //   autoFlushInterval - milliseconds elapsed since the first row of the batch was added, defaults to 1000
+    constructor(options, defaultAutoFlushRows) {
+        super();
+        this.bufferSize = options.bufferSize || DEFAULT_BUFFER_SIZE;
+        this.maxBufferSize = options.maxBufferSize || DEFAULT_MAX_BUFFER_SIZE;
+        this.symbolCacheSize = options.symbolCacheSize;
+        this.protocolVersion = options.protocolVersion || 1;
+        this.builder = createBuilder(this);
+        this.spareBuilders = [];
+        this.pendingRows = 0;
+        this.autoFlush = !!options.autoFlush;
+        this.autoFlushRows = options.autoFlushRows === undefined ? defaultAutoFlushRows : options.autoFlushRows;
+        this.autoFlushBytes = options.autoFlushBytes;
+        this.autoFlushInterval = options.autoFlushInterval === undefined
+            ? DEFAULT_AUTO_FLUSH_INTERVAL : options.autoFlushInterval;
+        this.flushTimer = null;
+    }
+
+    addTable(table) {
+        this.builder.addTable(table);
+        return this;
+    }
+
+    addSymbol(name, value) {
+        this.builder.addSymbol(name, value);
+        return this;
+    }
+
+    addString(name, value) {
+        this.builder.addString(name, value);
+        return this;
+    }
+
+    addBoolean(name, value) {
+        this.builder.addBoolean(name, value);
+        return this;
+    }
+
+    addFloat(name, value) {
+        this.builder.addFloat(name, value);
+        return this;
+    }
+
+    addInteger(name, value) {
+        this.builder.addInteger(name, value);
+        return this;
+    }
+
+    addTimestamp(name, value) {
+        this.builder.addTimestamp(name, value);
+        return this;
+    }
+
+    addArray(name, values) {
+        this.builder.addArray(name, values);
+        return this;
+    }
+
+    // discards the row being added, the rows already closed are kept
+    rollback() {
+        this.builder.rollback();
+        return this;
+    }
+
+    async at(timestamp) {
+        this.builder.at(timestamp);
+        await rowAdded(this);
+    }
+
+    async atNanos(timestamp) {
+        this.builder.atNanos(timestamp);
+        await rowAdded(this);
+    }
+
+    async atMicros(timestamp) {
+        this.builder.atMicros(timestamp);
+        await rowAdded(this);
+    }
+
+    async atMillis(timestamp) {
+        this.builder.atMillis(timestamp);
+        await rowAdded(this);
+    }
+
+    async atNow() {
+        this.builder.atNow();
+        await rowAdded(this);
+    }
+
+    // implemented by the transports, swaps the builder and starts sending the buffered rows
+    async startFlush() {
+        throw "startFlush() is not implemented";
+    }
+}
+
+async function rowAdded(sender) {
+    sender.pendingRows++;
+    if (!sender.autoFlush) {
+        return;
+    }
+    if ((sender.autoFlushRows && sender.pendingRows >= sender.autoFlushRows)
+        || (sender.autoFlushBytes && sender.builder.position >= sender.autoFlushBytes)) {
+        await sender.startFlush();
+    } else if (sender.autoFlushInterval && !sender.flushTimer) {
+        scheduleFlush(sender);
+    }
+}
+
+function scheduleFlush(sender) {
+    sender.flushTimer = setTimeout(() => {
+        sender.flushTimer = null;
+        if (sender.builder.hasTable) {
+            // a row is being added, cannot flush until it is closed
+            scheduleFlush(sender);
+            return;
+        }
+        sender.flush().catch(err => console.error(err));
+    }, sender.autoFlushInterval);
+    sender.flushTimer.unref();
+}
+
+function clearFlushTimer(sender) {
+    if (sender.flushTimer) {
+        clearTimeout(sender.flushTimer);
+        sender.flushTimer = null;
+    }
+}
+
+function createBuilder(sender) {
+    return new Builder(sender.bufferSize, {
+        maxBufferSize: sender.maxBufferSize,
+        protocolVersion: sender.protocolVersion,
+        symbolCacheSize: sender.symbolCacheSize,
+        allocUnsafe: true
+    });
+}
+
+exports.RowSender = RowSender;
+exports.clearFlushTimer = clearFlushTimer;
+exports.createBuilder = createBuilder;
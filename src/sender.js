@@ -1,86 +1,594 @@
-const { Socket } = require("net");
+const { Socket, isIP } = require("net");
+const tls = require("tls");
 const { Buffer } = require("buffer");
 const crypto = require('crypto');
+const { RowSender, clearFlushTimer, createBuilder } = require("./rowsender");
+const { SenderWritable, ingest } = require("./stream");
+const { SenderStats, flushed, reconnected, backpressureWaited } = require("./stats");
+const { Spool } = require("./spool");
+const { spans, tracePromise } = require("./trace");
 
-class Sender {
-    constructor(jwk = null) {
+const DEFAULT_AUTO_FLUSH_ROWS = 600;
+const DEFAULT_MAX_PENDING_FLUSHES = 1;
+const DEFAULT_HIGH_WATER_MARK = 1048576; // 1 MB
+const DEFAULT_RECONNECT_INITIAL_DELAY = 100; // 100 ms
+const DEFAULT_RECONNECT_MAX_DELAY = 10000; // 10 sec
+const DEFAULT_RECONNECT_MAX_RETRIES = 10;
+const DEFAULT_REPLAY_QUEUE_SIZE = 16777216; // 16 MB
+const NEWLINE = 10;
+
+const privateKeys = new WeakMap();
+
+class Sender extends RowSender {
+    // options:
+    //   bufferSize, maxBufferSize - initial and max size of the buffer rows are collected in
+    //   symbolCacheSize - number of symbol values cached with their escaped bytes by each buffer, see Builder
+    //   protocolVersion - 2 sends floats in binary and supports arrays, requires a server supporting it,
+    //                     defaults to 1, see Builder
+    //   autoFlush - if true, buffered rows are sent when any of the below thresholds is reached
+    //   autoFlushRows - number of rows, defaults to 600
+    //   autoFlushBytes - size of the buffered rows in bytes, not set by default
+    //   autoFlushInterval - milliseconds elapsed since the first row of the batch was added, defaults to 1000
+    //   maxPendingFlushes - number of flushed batches waiting to be written or being written at the same time,
+    //                       a flush over the limit waits for the oldest one to complete, defaults to 1
+    //   highWaterMark - if the number of bytes queued in the socket reaches this limit,
+    //                   send() waits until the queue is drained, defaults to 1 MB
+    //   reconnect - if true, the sender reconnects and authenticates again when the connection is lost,
+    //               data not yet written to the socket is replayed after the connection is re-established
+    //   reconnectInitialDelay, reconnectMaxDelay - delay before the first attempt and max delay in milliseconds,
+    //                                              the delay doubles after each failed attempt
+    //   reconnectMaxRetries - number of attempts before giving up, defaults to 10, ignored if spool is set
+    //   replayQueueSize - max number of bytes kept for replay, defaults to 16 MB
+    //   tls - if true, the connection is encrypted, sessions are resumed when reconnecting
+    //   tlsOptions - passed to tls.connect(), e.g. ca, or rejectUnauthorized
+    //   ciphers - cipher suites allowed, in OpenSSL cipher list format
+    //   spool - options of a Spool, see src/spool.js; if set, batches are appended to files while the sender is
+    //           disconnected or the replay queue is full, they are sent in order once connected again,
+    //           including after a restart of the process. Batches in the spool might be sent more than once.
+    //           With a spool the sender never gives up reconnecting, and without reconnect a connection error
+    //           does not exit the process, the batches are kept until connect() is called again.
+    //   pipelineAuth - if true, connect() returns once the key id has been sent instead of waiting for the challenge,
+    //                  data sent in the meantime is written right after the signed challenge
+    constructor(jwk = null, options = {}) {
+        super(options, DEFAULT_AUTO_FLUSH_ROWS);
         this.jwk = jwk;
-        this.socket = new Socket();
+        this.highWaterMark = options.highWaterMark || DEFAULT_HIGH_WATER_MARK;
+        this.tls = !!options.tls;
+        this.tlsOptions = options.ciphers ? { ...options.tlsOptions, ciphers: options.ciphers } : options.tlsOptions;
+        this.tlsSession = null;
+        this.socket = createSocket(this);
+        this.connected = false;
+        this.closing = false;
+        this.pipelineAuth = !!options.pipelineAuth;
+        this.authenticating = null;
 
-        this.socket.on("close", async () => {
-            console.log("connection closed");
-        });
+        this.autoReconnect = !!options.reconnect;
+        this.reconnectInitialDelay = options.reconnectInitialDelay || DEFAULT_RECONNECT_INITIAL_DELAY;
+        this.reconnectMaxDelay = options.reconnectMaxDelay || DEFAULT_RECONNECT_MAX_DELAY;
+        this.reconnectMaxRetries = options.reconnectMaxRetries === undefined
+            ? DEFAULT_RECONNECT_MAX_RETRIES : options.reconnectMaxRetries;
+        this.replayQueueSize = options.replayQueueSize || DEFAULT_REPLAY_QUEUE_SIZE;
+        this.replayQueue = [];
+        this.replayQueueBytes = 0;
 
-        this.socket.on("error", async err => {
-            console.error(err);
-            process.exit(1);
-        });
+        this.maxPendingFlushes = options.maxPendingFlushes || DEFAULT_MAX_PENDING_FLUSHES;
+        this.pendingFlushes = [];
+        this.flushing = null;
+        this.lastSequence = 0;
+        this.completedSequence = 0;
+        this.stats = new SenderStats();
+        this.spool = options.spool ? new Spool(options.spool) : null;
+        this.draining = null;
     }
 
     async connect(port, host) {
-        let self = this;
-        let authenticated = false;
-
-        return new Promise((resolve, reject) => {
-            let data;
-            this.socket.on("data", async raw => {
-                data = !data ? raw : Buffer.concat([data, raw]);
-                //console.log(`received: ${data}`);
-                if (!authenticated) {
-                    authenticated = await authenticate(self, data);
-                    authenticated ? resolve(true) : reject(false);
-                }
-            });
-
-            this.socket.on("ready", async () => {
-                console.log("connection ready");
-                if (self.jwk) {
-                    console.log("authenticating with server");
-                    await self.send(`${self.jwk.kid}\n`);
-                } else {
-                    console.log("no authentication");
-                    authenticated = true;
-                    resolve(true);
-                }
-            });
+        this.port = port;
+        this.host = host;
+        if (this.socket.destroyed) {
+            // connecting again after the connection was lost
+            this.socket = createSocket(this);
+        }
+        const { connected, authenticated } = handshake(this);
+        if (!this.pipelineAuth || !this.jwk) {
+            await authenticated;
+            this.connected = true;
+            replay(this);
+            startDrain(this);
+            return true;
+        }
 
-            this.socket.connect(port, host);
-        });
+        // data sent before the challenge has been signed is written straight after the signature
+        this.authenticating = authenticated.finally(() => this.authenticating = null);
+        this.authenticating.catch(() => {});
+        await connected;
+        this.connected = true;
+        this.authenticating.then(() => {
+            replay(this);
+            startDrain(this);
+        }, () => {});
+        return true;
     }
 
     async close() {
-        console.log("closing connection")
-        return new Promise(resolve => {
+        try {
+            await this.flush();
+            if (this.draining) {
+                await this.draining;
+            }
+        } finally {
+            if (this.spool) {
+                this.spool.close();
+            }
+            this.closing = true;
+            console.log("closing connection")
             this.socket.destroy();
-            resolve();
-        });
+        }
+    }
+
+    // Resolves when the buffered rows and the batches flushed before them have been written,
+    // with the sequence number of the last completed flush. Fails if any of the pending flushes failed.
+    async flush() {
+        await startFlush(this);
+        await Promise.all(this.pendingFlushes.map(pending => pending.completed));
+        return this.completedSequence;
+    }
+
+    startFlush() {
+        return startFlush(this);
+    }
+
+    // returns an object mode stream the rows can be piped into, see SenderWritable
+    writable(options = {}) {
+        return new SenderWritable(this, options);
+    }
+
+    // sends the rows of an async iterable, resolves with the number of rows when all of them are sent
+    async ingest(iterable, options = {}) {
+        return ingest(this, iterable, options);
+    }
+
+    get queuedBytes() {
+        return this.socket.writableLength;
+    }
+
+    // Counters since the sender was created. Flush latency is measured from starting the flush until
+    // the batch has been written, it is the sum of the queue latency, waiting for the flushes before it
+    // and for the socket to drain, and the wire latency, writing the batch. All times are in milliseconds.
+    getStats() {
+        const stats = this.stats;
+        return {
+            rowsSent: stats.rowsSent,
+            bytesSent: stats.bytesSent,
+            pendingRows: this.pendingRows,
+            flushes: stats.flushes,
+            failedFlushes: stats.failedFlushes,
+            flushLatency: stats.flushLatency.snapshot(),
+            queueLatency: stats.queueLatency.snapshot(),
+            wireLatency: stats.wireLatency.snapshot(),
+            pendingFlushes: this.pendingFlushes.length,
+            lastSequence: this.lastSequence,
+            completedSequence: this.completedSequence,
+            queuedBytes: this.queuedBytes,
+            replayQueueBytes: this.replayQueueBytes,
+            reconnects: stats.reconnects,
+            backpressureWaits: stats.backpressureWaits,
+            backpressureTime: stats.backpressureTime
+        };
     }
 
     async send(data) {
-        return new Promise(resolve => {
-            this.socket.write(data, 'utf8', () => {
+        return this.sendMany([data]);
+    }
+
+    // Sends multiple batches, e.g. the buffers of several builders, with a single write to the kernel.
+    // The socket is corked while the batches are queued, so they are written together with writev().
+    async sendMany(buffers) {
+        return sendBatches(this, buffers, null);
+    }
+}
+
+// flush is the record of the flush the batches are sent by, if any, the time writing starts is set in it
+async function sendBatches(sender, buffers, flush) {
+    if (sender.authenticating) {
+        await sender.authenticating;
+    }
+    // the last write() returned false, the socket's write queue is full
+    if (sender.socket.writableNeedDrain && !sender.socket.destroyed) {
+        const start = process.hrtime.bigint();
+        while (sender.socket.writableNeedDrain && !sender.socket.destroyed) {
+            await waitForDrain(sender);
+        }
+        backpressureWaited(sender, start);
+    }
+    if (flush) {
+        flush.written = process.hrtime.bigint();
+    }
+    if (sender.spool && (!sender.connected || sender.draining || !sender.spool.empty)) {
+        // keeps the order, nothing is sent directly until the spool is drained
+        spoolBatches(sender, buffers);
+        return;
+    }
+    if (!sender.autoReconnect) {
+        await corked(sender.socket, () => Promise.all(buffers.map(data => write(sender.socket, data))));
+        for (const data of buffers) {
+            sender.stats.bytesSent += Buffer.byteLength(data);
+        }
+        return;
+    }
+
+    let length = 0;
+    const entries = buffers.map(data => {
+        const entry = { data, length: Buffer.byteLength(data) };
+        length += entry.length;
+        return entry;
+    });
+    if (sender.replayQueueBytes + length > sender.replayQueueSize) {
+        if (sender.spool) {
+            spoolBatches(sender, buffers);
+            return;
+        }
+        throw `Replay queue is full [queued=${sender.replayQueueBytes}, replayQueueSize=${sender.replayQueueSize}]`;
+    }
+    const written = entries.map(entry => new Promise((resolve, reject) => {
+        entry.resolve = resolve;
+        entry.reject = reject;
+    }));
+    sender.replayQueue.push(...entries);
+    sender.replayQueueBytes += length;
+    if (sender.connected) {
+        corked(sender.socket, () => entries.forEach(entry => writeEntry(sender, entry)));
+    }
+    await Promise.all(written);
+    sender.stats.bytesSent += length;
+}
+
+// Rows are collected in a builder while the builders flushed before are written to the socket,
+// up to maxPendingFlushes of them. Flushes are numbered in the order they were started, and they complete
+// in that order, the batch of a flush is written after the batches of the flushes before it.
+// A builder is reused only after its write completed.
+async function startFlush(sender) {
+    clearFlushTimer(sender);
+    while (sender.pendingFlushes.length >= sender.maxPendingFlushes) {
+        await sender.pendingFlushes[0].completed;
+    }
+    if (sender.pendingRows < 1) {
+        return;
+    }
+
+    const builder = sender.builder;
+    const data = builder.toBuffer();
+    sender.builder = sender.spareBuilders.pop() || createBuilder(sender);
+    const flush = {
+        sequence: ++sender.lastSequence,
+        rows: sender.pendingRows,
+        bytes: data.length,
+        start: process.hrtime.bigint(),
+        written: null,
+        end: null
+    };
+    sender.pendingRows = 0;
+
+    const context = { sender, sequence: flush.sequence, rows: flush.rows, bytes: flush.bytes };
+    const sending = tracePromise(spans.flush, () => sendBatches(sender, [data], flush), context)
+        .finally(() => flush.end = process.hrtime.bigint());
+    sending.catch(() => {});
+    // a flush is reported only after the flushes before it, even if its write completed earlier
+    const previous = sender.pendingFlushes[sender.pendingFlushes.length - 1];
+    const completed = (previous ? previous.completed.then(() => {}, () => {}) : Promise.resolve())
+        .then(() => sending)
+        .then(
+            () => flushed(sender, flush),
+            err => {
+                flushed(sender, flush, err);
+                throw err;
+            }
+        ).finally(() => {
+            builder.reset();
+            if (sender.spareBuilders.length < sender.maxPendingFlushes) {
+                sender.spareBuilders.push(builder);
+            }
+            sender.pendingFlushes.shift();
+            sender.completedSequence = flush.sequence;
+            if (sender.flushing === completed) {
+                sender.flushing = null;
+            }
+        });
+    // a failed write is reported to the callers awaiting the flush, or to the next flush
+    completed.catch(() => {});
+    sender.pendingFlushes.push({ sequence: flush.sequence, completed });
+    sender.flushing = completed;
+}
+
+function waitForDrain(sender) {
+    if (!sender.drained) {
+        const socket = sender.socket;
+        sender.drained = new Promise(resolve => {
+            const done = () => {
+                socket.off("drain", done);
+                socket.off("close", done);
+                sender.drained = null;
                 resolve();
-            });
+            };
+            socket.on("drain", done);
+            socket.on("close", done);
+        });
+    }
+    return sender.drained;
+}
+
+function createSocket(sender, socket = new Socket({ writableHighWaterMark: sender.highWaterMark })) {
+
+    socket.on("close", async () => {
+        console.log("connection closed");
+        if (socket !== sender.socket || !sender.connected) {
+            // a failed reconnect attempt, or the connection was never established
+            return;
+        }
+        sender.connected = false;
+        sender.emit("disconnect");
+        if (sender.spool) {
+            spoolReplayQueue(sender);
+        }
+        if (sender.autoReconnect && !sender.closing) {
+            await tracePromise(spans.reconnect, () => reconnect(sender), { sender, host: sender.host, port: sender.port });
+            return;
+        }
+        sender.emit("close");
+    });
+
+    socket.on("error", async err => {
+        if ((sender.autoReconnect || sender.spool) && !sender.closing) {
+            // the socket is closed after the error, it is handled in the close event,
+            // the batches are kept in the replay queue or in the spool
+            console.error(`connection error: ${err}`);
+            return;
+        }
+        if (sender.listenerCount("error") > 0) {
+            sender.emit("error", err);
+            return;
+        }
+        console.error(err);
+        process.exit(1);
+    });
+
+    return socket;
+}
+
+// Returns two promises, connected resolves when the connection is ready and the key id has been sent,
+// authenticated resolves when the signed challenge has been sent too, or straight away without authentication.
+function handshake(sender) {
+    if (sender.tls) {
+        // TLS sockets are connected when they are created, the unconnected plain socket is not used
+        sender.socket.destroy();
+        sender.socket = createSocket(sender, connectTls(sender));
+    }
+    const socket = sender.socket;
+    let keyIdSent;
+    const connected = new Promise((resolve, reject) => keyIdSent = { resolve, reject });
+    // rejected together with authenticated, which is the one reported
+    connected.catch(() => {});
+
+    const context = { sender, host: sender.host, port: sender.port };
+    const authenticated = tracePromise(spans.handshake, () => new Promise((resolve, reject) => {
+        const chunks = [];
+        const onData = raw => {
+            chunks.push(raw);
+            // the challenge ends with \n
+            if (raw[raw.length - 1] !== NEWLINE) {
+                return;
+            }
+            socket.off("data", onData);
+            authenticate(sender, Buffer.concat(chunks)).then(resolve, reject);
+        };
+
+        socket.on(sender.tls ? "secureConnect" : "ready", async () => {
+            console.log("connection ready");
+            if (sender.jwk) {
+                console.log("authenticating with server");
+                socket.on("data", onData);
+                try {
+                    await write(socket, `${sender.jwk.kid}\n`);
+                } catch (err) {
+                    keyIdSent.reject(err);
+                    reject(err);
+                    return;
+                }
+                keyIdSent.resolve(true);
+            } else {
+                console.log("no authentication");
+                keyIdSent.resolve(true);
+                resolve(true);
+            }
+        });
+
+        socket.once("error", err => {
+            keyIdSent.reject(err);
+            reject(err);
         });
+        if (!sender.tls) {
+            socket.connect(sender.port, sender.host);
+        }
+    }), context);
+    return { connected, authenticated };
+}
+
+// The last session is kept, so reconnecting can skip the full TLS handshake.
+// The host name is sent for SNI unless it is an IP address, as https.Agent does.
+function connectTls(sender) {
+    const tlsOptions = sender.tlsOptions || {};
+    const socket = tls.connect({
+        ...tlsOptions,
+        port: sender.port,
+        host: sender.host,
+        servername: tlsOptions.servername || (isIP(sender.host || "") ? undefined : sender.host),
+        session: sender.tlsSession,
+        highWaterMark: sender.highWaterMark
+    });
+    socket.on("session", session => sender.tlsSession = session);
+    return socket;
+}
+
+async function reconnect(sender) {
+    let delay = sender.reconnectInitialDelay;
+    // the batches are appended to the spool while disconnected, so there is no reason to give up
+    const maxRetries = sender.spool ? Infinity : sender.reconnectMaxRetries;
+    for (let attempt = 1; attempt <= maxRetries; attempt++) {
+        await sleep(delay);
+        if (sender.closing) {
+            return;
+        }
+        console.log(`reconnecting, attempt ${attempt}`);
+        sender.socket = createSocket(sender);
+        try {
+            await handshake(sender).authenticated;
+            sender.connected = true;
+            reconnected(sender, attempt);
+            sender.emit("reconnect");
+            replay(sender);
+            startDrain(sender);
+            return;
+        } catch (err) {
+            sender.socket.destroy();
+        }
+        delay = Math.min(delay * 2, sender.reconnectMaxDelay);
+    }
+
+    const message = `Could not reconnect to ${sender.host}:${sender.port} after ${sender.reconnectMaxRetries} attempts`;
+    const entries = sender.replayQueue;
+    sender.replayQueue = [];
+    sender.replayQueueBytes = 0;
+    for (const entry of entries) {
+        entry.reject(message);
+    }
+    if (sender.listenerCount("error") > 0) {
+        sender.emit("error", message);
+        return;
+    }
+    console.error(message);
+    process.exit(1);
+}
+
+// writes the batches not acknowledged by the write callback of the previous connection
+function replay(sender) {
+    corked(sender.socket, () => {
+        for (const entry of sender.replayQueue) {
+            writeEntry(sender, entry);
+        }
+    });
+}
+
+function spoolBatches(sender, buffers) {
+    for (const data of buffers) {
+        sender.spool.append(data);
     }
+    startDrain(sender);
+}
+
+// the batches not written to the socket before the connection was lost are moved to the spool
+function spoolReplayQueue(sender) {
+    const entries = sender.replayQueue;
+    sender.replayQueue = [];
+    sender.replayQueueBytes = 0;
+    for (const entry of entries) {
+        try {
+            sender.spool.append(entry.data);
+            entry.resolve();
+        } catch (err) {
+            entry.reject(err);
+        }
+    }
+}
+
+function startDrain(sender) {
+    if (!sender.spool || sender.draining || !sender.connected || sender.spool.empty) {
+        return;
+    }
+    sender.draining = drainSpool(sender).then(drained => {
+        sender.draining = null;
+        if (drained) {
+            // batches might have been appended after the last one was read
+            startDrain(sender);
+        }
+    }, err => {
+        sender.draining = null;
+        console.error(`sending the spooled batches failed: ${err}`);
+    });
+}
+
+// Sends the spooled batches one by one, a batch is removed from the spool after it has been written.
+// Returns false if a write failed, the batch stays in the spool and it is sent again when connected.
+async function drainSpool(sender) {
+    let data;
+    while (sender.connected && (data = sender.spool.peek()) !== null) {
+        while (sender.socket.writableNeedDrain && !sender.socket.destroyed) {
+            await waitForDrain(sender);
+        }
+        const socket = sender.socket;
+        const error = await new Promise(resolve => socket.write(data, resolve));
+        if (error || socket !== sender.socket) {
+            return false;
+        }
+        sender.spool.shift();
+        sender.stats.bytesSent += data.length;
+    }
+    return sender.connected;
+}
+
+function writeEntry(sender, entry) {
+    sender.socket.write(entry.data, 'utf8', err => {
+        if (err) {
+            // the entry stays in the queue, it is written again after reconnecting
+            return;
+        }
+        const index = sender.replayQueue.indexOf(entry);
+        if (index > -1) {
+            sender.replayQueue.splice(index, 1);
+            sender.replayQueueBytes -= entry.length;
+            entry.resolve();
+        }
+    });
+}
+
+function corked(socket, writeAll) {
+    socket.cork();
+    try {
+        return writeAll();
+    } finally {
+        socket.uncork();
+    }
+}
+
+// rejects if the data could not be written, e.g. the connection has been reset or the socket is destroyed
+function write(socket, data) {
+    return new Promise((resolve, reject) => {
+        socket.write(data, 'utf8', err => {
+            if (err) {
+                reject(`Write failed [error=${err.message}]`);
+                return;
+            }
+            resolve();
+        });
+    });
+}
+
+function sleep(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
 }
 
 async function authenticate(sender, challenge) {
-    // Check for trailing \n which ends the challenge
-    if (challenge.slice(-1).readInt8() === 10) {
-        const keyObject = await crypto.createPrivateKey(
-            {'key': sender.jwk, 'format': 'jwk'}
-        );
-        const signature = await crypto.sign(
-            "RSA-SHA256",
-            challenge.slice(0, challenge.length - 1),
-            keyObject
-        );
-
-        await sender.send(`${Buffer.from(signature).toString("base64")}\n`);
-        return true;
+    const signature = crypto.sign("RSA-SHA256", challenge.subarray(0, challenge.length - 1), privateKey(sender.jwk));
+    await write(sender.socket, `${Buffer.from(signature).toString("base64")}\n`);
+    return true;
+}
+
+// the key is parsed only once, senders created with the same jwk object share it
+function privateKey(jwk) {
+    let keyObject = privateKeys.get(jwk);
+    if (!keyObject) {
+        keyObject = crypto.createPrivateKey({ key: jwk, format: "jwk" });
+        privateKeys.set(jwk, keyObject);
     }
-    return false;
+    return keyObject;
 }
 
 exports.Sender = Sender;
@@ -0,0 +1,196 @@
+const { Sender } = require("./sender");
+
+const DEFAULT_CONNECTIONS = 1;
+const DEFAULT_UNHEALTHY_DELAY = 1000; // 1 sec
+const DEFAULT_MAX_UNHEALTHY_DELAY = 30000; // 30 sec
+const STRATEGIES = ["roundRobin", "leastLatency"];
+// weight of the last send in the moving average of the latency
+const LATENCY_WEIGHT = 0.2;
+// added to the latency, so connections without measurements yet are not all equal to zero
+const MIN_LATENCY = 0.1;
+
+// Spreads batches across multiple connections, opened to one or more hosts.
+// Batches sent without a table name are distributed by the strategy, batches of the same table
+// go to the same connection while it is healthy, so the rows of a table are received in order.
+// A connection is unhealthy while it is reconnecting, or for a while after it was lost or a send failed via it,
+// the batch is sent again via another connection. Unhealthy connections are used only if none is healthy.
+class SenderPool {
+    // options:
+    //   connections - number of connections opened to each host, defaults to 1
+    //   strategy - "roundRobin", or "leastLatency" which picks the connection with the lowest
+    //              moving average of the send latency, weighted by the number of batches being sent
+    //              via it and the bytes queued in its socket, defaults to "roundRobin"
+    //   unhealthyDelay - milliseconds a connection is skipped after a failed send, doubles after
+    //                    each consecutive failure up to maxUnhealthyDelay, defaults to 1 sec and 30 sec
+    //   any other option is passed to the senders
+    constructor(jwk = null, options = {}) {
+        this.jwk = jwk;
+        this.options = options;
+        this.connections = options.connections || DEFAULT_CONNECTIONS;
+        this.strategy = options.strategy || STRATEGIES[0];
+        if (!STRATEGIES.includes(this.strategy)) {
+            throw `Unknown strategy: ${this.strategy}, available strategies: ${STRATEGIES.join(", ")}`;
+        }
+        this.unhealthyDelay = options.unhealthyDelay || DEFAULT_UNHEALTHY_DELAY;
+        this.maxUnhealthyDelay = options.maxUnhealthyDelay || DEFAULT_MAX_UNHEALTHY_DELAY;
+        this.senders = [];
+        this.states = new Map();
+        this.next = 0;
+    }
+
+    // hosts is an array of { port, host } objects
+    async connect(hosts) {
+        const connecting = [];
+        for (const { port, host } of hosts) {
+            for (let i = 0; i < this.connections; i++) {
+                const sender = new Sender(this.jwk, this.options);
+                sender.on("error", err => {
+                    console.error(`connection to ${host}:${port} failed: ${err}`);
+                    remove(this, sender);
+                });
+                sender.on("close", () => remove(this, sender));
+                // a reconnecting sender stays in the pool, it is skipped until the backoff expires
+                sender.on("disconnect", () => unhealthy(this, sender, "connection lost"));
+                this.states.set(sender, { host, port, latency: 0, pending: 0, failures: 0, retryAt: 0 });
+                connecting.push(sender.connect(port, host).then(() => sender));
+            }
+        }
+
+        const results = await Promise.allSettled(connecting);
+        for (const result of results) {
+            if (result.status === "fulfilled" && !result.value.socket.destroyed) {
+                this.senders.push(result.value);
+            }
+        }
+        if (this.senders.length < 1) {
+            throw "Could not connect to any of the hosts";
+        }
+        return true;
+    }
+
+    get size() {
+        return this.senders.length;
+    }
+
+    // sends the batch via another connection if it fails, until it has been tried via all of them
+    async send(data, table = null) {
+        const tried = new Set();
+        let error = "There is no connection available";
+        let sender;
+        while ((sender = select(this, table, tried)) !== null) {
+            tried.add(sender);
+            try {
+                await sendVia(this, sender, data);
+                return;
+            } catch (err) {
+                error = err;
+                unhealthy(this, sender, err);
+            }
+        }
+        throw error;
+    }
+
+    // the state of each connection, latency is the moving average in milliseconds
+    getStats() {
+        const now = Date.now();
+        return {
+            connections: this.senders.map(sender => {
+                const state = this.states.get(sender);
+                return {
+                    host: state.host,
+                    port: state.port,
+                    healthy: healthy(this, sender, now),
+                    latency: state.latency,
+                    pending: state.pending,
+                    queuedBytes: sender.queuedBytes,
+                    failures: state.failures
+                };
+            })
+        };
+    }
+
+    async close() {
+        const senders = this.senders;
+        this.senders = [];
+        await Promise.all(senders.map(sender => sender.close()));
+    }
+}
+
+function remove(pool, sender) {
+    const index = pool.senders.indexOf(sender);
+    if (index > -1) {
+        pool.senders.splice(index, 1);
+    }
+}
+
+// Picks one of the healthy connections not tried yet, or one of the unhealthy ones if there is no healthy left.
+// Returns null if all connections have been tried.
+function select(pool, table, tried) {
+    const now = Date.now();
+    const candidates = pool.senders.filter(sender => !tried.has(sender));
+    if (candidates.length < 1) {
+        return null;
+    }
+    const healthySenders = candidates.filter(sender => healthy(pool, sender, now));
+    const senders = healthySenders.length > 0 ? healthySenders : candidates;
+    if (table !== null) {
+        return senders[hash(table) % senders.length];
+    }
+    if (pool.strategy === "leastLatency") {
+        let selected = senders[0];
+        let minCost = cost(pool, selected);
+        for (let i = 1; i < senders.length; i++) {
+            const senderCost = cost(pool, senders[i]);
+            if (senderCost < minCost) {
+                selected = senders[i];
+                minCost = senderCost;
+            }
+        }
+        return selected;
+    }
+    return senders[pool.next++ % senders.length];
+}
+
+function healthy(pool, sender, now) {
+    return sender.connected && !sender.socket.destroyed && pool.states.get(sender).retryAt <= now;
+}
+
+// estimated time to send a batch, the latency of a send multiplied by the sends queued before it
+function cost(pool, sender) {
+    const state = pool.states.get(sender);
+    const queued = state.pending + (sender.queuedBytes + sender.replayQueueBytes) / sender.highWaterMark;
+    return (state.latency + MIN_LATENCY) * (1 + queued);
+}
+
+async function sendVia(pool, sender, data) {
+    const state = pool.states.get(sender);
+    state.pending++;
+    const start = process.hrtime.bigint();
+    try {
+        await sender.send(data);
+    } finally {
+        state.pending--;
+    }
+    const latency = Number(process.hrtime.bigint() - start) / 1e6;
+    state.latency = state.latency === 0 ? latency : state.latency + LATENCY_WEIGHT * (latency - state.latency);
+    state.failures = 0;
+    state.retryAt = 0;
+}
+
+function unhealthy(pool, sender, err) {
+    const state = pool.states.get(sender);
+    state.failures++;
+    const delay = Math.min(pool.unhealthyDelay * 2 ** (state.failures - 1), pool.maxUnhealthyDelay);
+    state.retryAt = Date.now() + delay;
+    console.error(`${state.host}:${state.port} is unhealthy, skipping it for ${delay} ms: ${err}`);
+}
+
+function hash(table) {
+    let hash = 0;
+    for (let i = 0; i < table.length; i++) {
+        hash = (hash * 31 + table.charCodeAt(i)) | 0;
+    }
+    return hash >>> 0;
+}
+
+exports.SenderPool = SenderPool;
@@ -0,0 +1,178 @@
+const fs = require("fs");
+const path = require("path");
+const { Buffer } = require("buffer");
+
+const DEFAULT_SEGMENT_SIZE = 67108864; // 64 MB
+const DEFAULT_MAX_SIZE = 1073741824; // 1 GB
+const DEFAULT_SYNC_INTERVAL = 1000; // 1 sec
+const HEADER_SIZE = 4;
+const SEGMENT_EXTENSION = ".spool";
+const SEGMENT_NAME_LENGTH = 12;
+
+// Append-only store for batches which could not be sent, kept in segment files in a directory.
+// Each record is the length of the batch as uint32 LE followed by the batch. Writes go to the page cache
+// and are fsync'ed in batches every syncInterval milliseconds, and when the spool is closed.
+// Batches are read back in the order they were appended; a segment is deleted when all of its batches
+// have been read. Batches read but not shifted before the process stopped are read again after a restart.
+class Spool {
+    // options:
+    //   directory - where the segment files are kept, created if it does not exist
+    //   segmentSize - a new segment file is started when the current one reaches this size, defaults to 64 MB
+    //   maxSize - max number of bytes kept in the spool, defaults to 1 GB
+    //   syncInterval - milliseconds between fsync calls, defaults to 1000
+    constructor(options = {}) {
+        if (!options.directory) {
+            throw "Spool directory must be set";
+        }
+        this.directory = options.directory;
+        this.segmentSize = options.segmentSize || DEFAULT_SEGMENT_SIZE;
+        this.maxSize = options.maxSize || DEFAULT_MAX_SIZE;
+        this.syncInterval = options.syncInterval || DEFAULT_SYNC_INTERVAL;
+        this.syncTimer = null;
+
+        fs.mkdirSync(this.directory, { recursive: true });
+        // segments are named by increasing sequence numbers, zero padded so they sort by name
+        this.segments = fs.readdirSync(this.directory)
+            .filter(name => name.endsWith(SEGMENT_EXTENSION))
+            .sort()
+            .map(name => {
+                const file = path.join(this.directory, name);
+                return { id: parseInt(name), file: file, size: fs.statSync(file).size };
+            });
+        this.size = this.segments.reduce((size, segment) => size + segment.size, 0);
+        this.nextId = this.segments.length > 0 ? this.segments[this.segments.length - 1].id + 1 : 1;
+        this.writeFd = null;
+        this.readFd = null;
+        this.readOffset = 0;
+        // length of the record at readOffset, once its header has been read
+        this.nextLength = -1;
+    }
+
+    get empty() {
+        return this.size - this.readOffset <= 0;
+    }
+
+    append(data) {
+        const length = Buffer.byteLength(data);
+        if (this.size + HEADER_SIZE + length > this.maxSize) {
+            throw `Spool is full [size=${this.size}, maxSize=${this.maxSize}]`;
+        }
+        let segment = this.segments[this.segments.length - 1];
+        if (this.writeFd === null || segment.size >= this.segmentSize) {
+            segment = startSegment(this);
+        }
+        const header = Buffer.alloc(HEADER_SIZE);
+        header.writeUInt32LE(length);
+        fs.writevSync(this.writeFd, [header, typeof data === "string" ? Buffer.from(data) : data]);
+        segment.size += HEADER_SIZE + length;
+        this.size += HEADER_SIZE + length;
+        scheduleSync(this);
+    }
+
+    // returns the oldest batch without removing it, or null if the spool is empty
+    peek() {
+        const length = nextRecord(this);
+        if (length < 0) {
+            return null;
+        }
+        const data = Buffer.allocUnsafe(length);
+        fs.readSync(this.readFd, data, 0, length, this.readOffset + HEADER_SIZE);
+        return data;
+    }
+
+    // removes the oldest batch, after it has been sent; only its header is read if it has not been peeked
+    shift() {
+        const length = nextRecord(this);
+        if (length > -1) {
+            this.readOffset += HEADER_SIZE + length;
+            this.nextLength = -1;
+        }
+    }
+
+    sync() {
+        clearTimeout(this.syncTimer);
+        this.syncTimer = null;
+        if (this.writeFd !== null) {
+            fs.fsyncSync(this.writeFd);
+        }
+    }
+
+    close() {
+        this.sync();
+        closeFd(this, "writeFd");
+        closeFd(this, "readFd");
+    }
+}
+
+// Returns the length of the oldest complete record, or -1 if the spool is empty.
+// Segments read fully are removed, the header is read only once per record.
+function nextRecord(spool) {
+    if (spool.nextLength > -1) {
+        return spool.nextLength;
+    }
+    while (spool.segments.length > 0) {
+        const segment = spool.segments[0];
+        if (spool.readOffset < segment.size) {
+            if (spool.readFd === null) {
+                spool.readFd = fs.openSync(segment.file, "r");
+            }
+            const header = Buffer.alloc(HEADER_SIZE);
+            fs.readSync(spool.readFd, header, 0, HEADER_SIZE, spool.readOffset);
+            const length = header.readUInt32LE();
+            if (spool.readOffset + HEADER_SIZE + length <= segment.size) {
+                spool.nextLength = length;
+                return length;
+            }
+            // the last record is incomplete, the process stopped while it was appended
+            console.error(`discarding incomplete record at the end of ${segment.file}`);
+        }
+        removeSegment(spool);
+    }
+    return -1;
+}
+
+function startSegment(spool) {
+    if (spool.writeFd !== null) {
+        fs.fsyncSync(spool.writeFd);
+        closeFd(spool, "writeFd");
+    }
+    const name = `${String(spool.nextId).padStart(SEGMENT_NAME_LENGTH, "0")}${SEGMENT_EXTENSION}`;
+    const segment = { id: spool.nextId++, file: path.join(spool.directory, name), size: 0 };
+    spool.writeFd = fs.openSync(segment.file, "a");
+    spool.segments.push(segment);
+    return segment;
+}
+
+// deletes the segment which has been read fully, including the one being appended to
+function removeSegment(spool) {
+    const segment = spool.segments.shift();
+    closeFd(spool, "readFd");
+    if (spool.segments.length < 1) {
+        closeFd(spool, "writeFd");
+    }
+    fs.unlinkSync(segment.file);
+    spool.size -= segment.size;
+    spool.readOffset = 0;
+    spool.nextLength = -1;
+}
+
+function scheduleSync(spool) {
+    if (spool.syncTimer === null) {
+        spool.syncTimer = setTimeout(() => {
+            spool.syncTimer = null;
+            if (spool.writeFd !== null) {
+                fs.fsync(spool.writeFd, err => err && console.error(`spool fsync failed: ${err}`));
+            }
+        }, spool.syncInterval);
+        spool.syncTimer.unref();
+    }
+}
+
+function closeFd(spool, name) {
+    if (spool[name] !== null) {
+        fs.closeSync(spool[name]);
+        spool[name] = null;
+    }
+}
+
+exports.Spool = Spool;
@@ -0,0 +1,143 @@
+const diagnostics = require("diagnostics_channel");
+const { sampling, recordPhase } = require("./trace");
+
+// upper bounds of the latency buckets in milliseconds
+const LATENCY_BUCKETS = [0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, Infinity];
+
+// Published when a batch has been written to the socket, or the write failed:
+//   { sender, sequence, rows, bytes, duration, queueTime, wireTime, error }
+const flushChannel = diagnostics.channel("questdb:sender:flush");
+// Published when the connection has been re-established: { sender, attempts }
+const reconnectChannel = diagnostics.channel("questdb:sender:reconnect");
+// Published after waiting for the socket to drain: { sender, duration }
+const backpressureChannel = diagnostics.channel("questdb:sender:backpressure");
+
+// Histogram with fixed buckets, min, max and sum are exact, percentiles are approximated by bucket upper bounds.
+class Histogram {
+    constructor(bounds = LATENCY_BUCKETS) {
+        this.bounds = bounds;
+        this.counts = new Array(bounds.length).fill(0);
+        this.count = 0;
+        this.sum = 0;
+        this.min = Infinity;
+        this.max = 0;
+    }
+
+    record(value) {
+        let i = 0;
+        while (value > this.bounds[i]) {
+            i++;
+        }
+        this.counts[i]++;
+        this.count++;
+        this.sum += value;
+        this.min = Math.min(this.min, value);
+        this.max = Math.max(this.max, value);
+    }
+
+    percentile(p) {
+        if (this.count < 1) {
+            return 0;
+        }
+        const rank = Math.ceil(this.count * p / 100);
+        let seen = 0;
+        for (let i = 0; i < this.counts.length; i++) {
+            seen += this.counts[i];
+            if (seen >= rank) {
+                // the last bucket is open, max is a better estimate than Infinity
+                return Math.min(this.bounds[i], this.max);
+            }
+        }
+        return this.max;
+    }
+
+    snapshot() {
+        const buckets = {};
+        for (let i = 0; i < this.bounds.length; i++) {
+            buckets[this.bounds[i] === Infinity ? "+Inf" : this.bounds[i]] = this.counts[i];
+        }
+        return {
+            count: this.count,
+            sum: this.sum,
+            min: this.count > 0 ? this.min : 0,
+            max: this.max,
+            mean: this.count > 0 ? this.sum / this.count : 0,
+            p50: this.percentile(50),
+            p90: this.percentile(90),
+            p99: this.percentile(99),
+            buckets: buckets
+        };
+    }
+}
+
+class SenderStats {
+    constructor() {
+        this.rowsSent = 0;
+        this.bytesSent = 0;
+        this.flushes = 0;
+        this.failedFlushes = 0;
+        this.flushLatency = new Histogram();
+        // time waiting for the flushes before and for the socket to drain, and time writing the batch
+        this.queueLatency = new Histogram();
+        this.wireLatency = new Histogram();
+        this.reconnects = 0;
+        this.backpressureWaits = 0;
+        this.backpressureTime = 0;
+    }
+}
+
+function elapsedMillis(start) {
+    return millis(start, process.hrtime.bigint());
+}
+
+function millis(start, end) {
+    return Number(end - start) / 1e6;
+}
+
+// flush holds the sequence number, size and the hrtime timestamps of the flush, see startFlush() of the Sender
+function flushed(sender, flush, error) {
+    const stats = sender.stats;
+    const end = flush.end || process.hrtime.bigint();
+    const written = flush.written || end;
+    const duration = millis(flush.start, end);
+    const queueTime = millis(flush.start, written);
+    const wireTime = millis(written, end);
+    if (error === undefined) {
+        stats.rowsSent += flush.rows;
+        stats.flushes++;
+        stats.flushLatency.record(duration);
+        stats.queueLatency.record(queueTime);
+        stats.wireLatency.record(wireTime);
+        if (sampling()) {
+            recordPhase("write", wireTime);
+        }
+    } else {
+        stats.failedFlushes++;
+    }
+    if (flushChannel.hasSubscribers) {
+        const { sequence, rows, bytes } = flush;
+        flushChannel.publish({ sender, sequence, rows, bytes, duration, queueTime, wireTime, error });
+    }
+}
+
+function reconnected(sender, attempts) {
+    sender.stats.reconnects++;
+    if (reconnectChannel.hasSubscribers) {
+        reconnectChannel.publish({ sender, attempts });
+    }
+}
+
+function backpressureWaited(sender, start) {
+    const duration = elapsedMillis(start);
+    sender.stats.backpressureWaits++;
+    sender.stats.backpressureTime += duration;
+    if (backpressureChannel.hasSubscribers) {
+        backpressureChannel.publish({ sender, duration });
+    }
+}
+
+exports.Histogram = Histogram;
+exports.SenderStats = SenderStats;
+exports.flushed = flushed;
+exports.reconnected = reconnected;
+exports.backpressureWaited = backpressureWaited;
@@ -0,0 +1,129 @@
+const { Writable, Readable } = require("stream");
+const { pipeline } = require("stream/promises");
+
+const DEFAULT_FLUSH_ROWS = 600;
+
+const COLUMN_TYPES = {
+    string: "string",
+    boolean: "boolean",
+    number: "float",
+    bigint: "integer"
+};
+
+// Object mode stream which writes rows to a sender, for example:
+//   source.pipe(new SenderWritable(sender));
+// Rows are objects like:
+//   { table: "trades", symbols: { pair: "BTC-USD" }, columns: { price: 20654.3, amount: { type: "integer", value: 25 } },
+//     timestamp: 1658484765000000000n }
+// The column type is taken from the type of the value (number is float, bigint is integer), or it can be set
+// explicitly as above. Column types: "string", "boolean", "float", "integer", "timestamp" and "array".
+// The timestamp is epoch nanos, without it the row is closed by atNow(). null and undefined values are skipped.
+// Unless the sender flushes automatically, the rows are flushed when flushRows is reached and when the stream ends.
+// The next row is accepted only after the flush completed, so memory stays bounded if the source is faster than the socket.
+class SenderWritable extends Writable {
+    // options:
+    //   flushRows - number of rows to flush after if the sender does not flush automatically, defaults to 600
+    //   any other option is passed to Writable
+    constructor(sender, options = {}) {
+        super({ highWaterMark: DEFAULT_FLUSH_ROWS, ...options, objectMode: true });
+        this.sender = sender;
+        this.flushRows = options.flushRows || DEFAULT_FLUSH_ROWS;
+        this.rows = 0;
+    }
+
+    _write(row, encoding, callback) {
+        writeRows(this, [row]).then(() => callback(), callback);
+    }
+
+    _writev(chunks, callback) {
+        writeRows(this, chunks.map(chunk => chunk.chunk)).then(() => callback(), callback);
+    }
+
+    _final(callback) {
+        this.sender.flush().then(() => callback(), callback);
+    }
+}
+
+// Writes the rows of the async iterable to the sender, resolves with the number of rows when all of them are sent.
+async function ingest(sender, iterable, options = {}) {
+    const writable = new SenderWritable(sender, options);
+    await pipeline(Readable.from(iterable), writable);
+    return writable.rows;
+}
+
+async function writeRows(writable, rows) {
+    const sender = writable.sender;
+    for (const row of rows) {
+        await writeRow(sender, row);
+        writable.rows++;
+        if (!sender.autoFlush && sender.pendingRows >= writable.flushRows) {
+            await sender.flush();
+        }
+    }
+}
+
+async function writeRow(sender, row) {
+    if (!row || typeof row !== "object") {
+        throw `Row must be an object, received ${row === null ? "null" : typeof row}`;
+    }
+    const { table, symbols = {}, columns = {}, timestamp } = row;
+    try {
+        sender.addTable(table);
+        for (const name of Object.keys(symbols)) {
+            const value = symbols[name];
+            if (value !== null && value !== undefined) {
+                sender.addSymbol(name, value);
+            }
+        }
+        for (const name of Object.keys(columns)) {
+            addColumn(sender, name, columns[name]);
+        }
+        await (timestamp === undefined || timestamp === null ? sender.atNow() : sender.at(timestamp));
+    } catch (e) {
+        // no-op if the row has been closed already
+        sender.rollback();
+        throw e;
+    }
+}
+
+function addColumn(sender, name, column) {
+    let type, value;
+    if (Array.isArray(column) || column instanceof Float64Array) {
+        type = "array";
+        value = column;
+    } else if (column !== null && typeof column === "object") {
+        type = column.type;
+        value = column.value;
+    } else {
+        type = COLUMN_TYPES[typeof column];
+        value = column;
+    }
+    if (value === null || value === undefined) {
+        return;
+    }
+    switch (type) {
+        case "string":
+            sender.addString(name, value);
+            break;
+        case "boolean":
+            sender.addBoolean(name, value);
+            break;
+        case "float":
+            sender.addFloat(name, value);
+            break;
+        case "integer":
+            sender.addInteger(name, value);
+            break;
+        case "timestamp":
+            sender.addTimestamp(name, value);
+            break;
+        case "array":
+            sender.addArray(name, value);
+            break;
+        default:
+            throw `Unsupported column type: ${type === undefined ? typeof value : type}`;
+    }
+}
+
+exports.SenderWritable = SenderWritable;
+exports.ingest = ingest;
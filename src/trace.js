@@ -0,0 +1,139 @@
+const diagnostics = require("diagnostics_channel");
+const { performance } = require("perf_hooks");
+
+const DEFAULT_SAMPLE_RATE = 0.001;
+const PHASES = ["validation", "escaping", "numbers", "write"];
+
+// Spans are published to tracing channels, e.g. tracing:questdb:sender:flush:start, asyncEnd and error,
+// see diagnostics_channel.tracingChannel(). The context of each span:
+//   toBuffer - { builder }
+//   flush - { sender, sequence, rows, bytes }
+//   handshake - { sender, host, port }
+//   reconnect - { sender, host, port }
+const spans = {
+    toBuffer: createSpan("questdb:builder:toBuffer"),
+    flush: createSpan("questdb:sender:flush"),
+    handshake: createSpan("questdb:sender:handshake"),
+    reconnect: createSpan("questdb:sender:reconnect")
+};
+
+const settings = {
+    marks: false,
+    sampleInterval: 0,
+    countdown: 0
+};
+
+const phases = {};
+resetPhaseTimings();
+
+function createSpan(name) {
+    return { name: name, channel: diagnostics.tracingChannel(name) };
+}
+
+// options:
+//   marks - if true, a performance.measure() entry is created for each span, they are delivered to
+//           PerformanceObserver instances and written to the trace log with --trace-event-categories node.perf,
+//           the entries are cleared from the timeline straight away, defaults to false
+//   sampleRate - fraction of the rows timed phase by phase, see getPhaseTimings(), 0 disables the sampling.
+//                The overhead grows with the rate, at the default of 1 in 1000 rows it is not measurable.
+function configureTracing(options = {}) {
+    settings.marks = !!options.marks;
+    const sampleRate = options.sampleRate === undefined ? DEFAULT_SAMPLE_RATE : options.sampleRate;
+    if (typeof sampleRate !== "number" || sampleRate < 0 || sampleRate > 1) {
+        throw `Sample rate must be a number between 0 and 1, received ${sampleRate}`;
+    }
+    settings.sampleInterval = sampleRate > 0 ? Math.round(1 / sampleRate) : 0;
+    settings.countdown = settings.sampleInterval;
+}
+
+// Time spent in each phase of the sampled rows in milliseconds: validation of the table and column names,
+// escaping of names and values, formatting of numbers and timestamps, and writing the batches to the socket.
+// Writes are timed for every flush while sampling is on, the other phases only for the sampled rows.
+function getPhaseTimings() {
+    const timings = {};
+    for (const phase of PHASES) {
+        const { count, time } = phases[phase];
+        timings[phase] = { count: count, time: time, mean: count > 0 ? time / count : 0 };
+    }
+    return timings;
+}
+
+function resetPhaseTimings() {
+    for (const phase of PHASES) {
+        phases[phase] = { count: 0, time: 0 };
+    }
+}
+
+function sampling() {
+    return settings.sampleInterval > 0;
+}
+
+// true for every sampleInterval-th row
+function sampleRow() {
+    if (settings.sampleInterval < 1 || --settings.countdown > 0) {
+        return false;
+    }
+    settings.countdown = settings.sampleInterval;
+    return true;
+}
+
+// calls fn with the arguments and adds its duration to the phase
+function timed(phase, fn, a, b, c) {
+    const start = performance.now();
+    try {
+        return fn(a, b, c);
+    } finally {
+        recordPhase(phase, performance.now() - start);
+    }
+}
+
+function recordPhase(phase, time) {
+    const timing = phases[phase];
+    timing.count++;
+    timing.time += time;
+}
+
+function traceSync(span, fn, context) {
+    if (!settings.marks && !span.channel.hasSubscribers) {
+        return fn();
+    }
+    const start = performance.now();
+    try {
+        return span.channel.traceSync(fn, context);
+    } finally {
+        measure(span, start, context);
+    }
+}
+
+// fn returns a promise, the span ends when it settles
+function tracePromise(span, fn, context) {
+    if (!settings.marks && !span.channel.hasSubscribers) {
+        return fn();
+    }
+    const start = performance.now();
+    const promise = span.channel.tracePromise(fn, context);
+    if (settings.marks) {
+        promise.then(() => measure(span, start, context), () => measure(span, start, context));
+    }
+    return promise;
+}
+
+function measure(span, start, context) {
+    if (!settings.marks) {
+        return;
+    }
+    const { sender, builder, ...detail } = context;
+    performance.measure(span.name, { start: start, end: performance.now(), detail: detail });
+    performance.clearMeasures(span.name);
+}
+
+exports.spans = spans;
+exports.configureTracing = configureTracing;
+exports.getPhaseTimings = getPhaseTimings;
+exports.resetPhaseTimings = resetPhaseTimings;
+exports.sampling = sampling;
+exports.sampleRow = sampleRow;
+exports.timed = timed;
+exports.recordPhase = recordPhase;
+exports.traceSync = traceSync;
+exports.tracePromise = tracePromise;
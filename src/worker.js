@@ -0,0 +1,91 @@
+const { Buffer } = require("buffer");
+const { parentPort } = require("worker_threads");
+const { Builder } = require("./builder");
+
+const BATCH = "questdb:batch";
+const BATCH_SENT = "questdb:batch-sent";
+
+// Builder to be used inside a worker thread.
+// The rows are written into SharedArrayBuffer backed buffers, flush() hands the buffer over
+// to the main thread without copying, where a Sender attached by connectWorker() writes it to the socket.
+// The builder switches to a spare buffer. A buffer is reused only after the main thread finished writing it.
+class WorkerBuilder extends Builder {
+    // options:
+    //   port - MessagePort connected to the main thread, defaults to parentPort
+    //   any other option is passed to Builder
+    constructor(bufferSize, options = {}) {
+        super(bufferSize, { ...options, shared: true });
+        this.port = options.port || parentPort;
+        if (!this.port) {
+            throw "WorkerBuilder has to be used in a worker thread, or a port has to be passed in the options";
+        }
+        this.nextId = 0;
+        this.callbacks = new Map();
+        this.spareBuffer = null;
+        this.flushing = null;
+        this.onMessage = message => batchSent(this, message);
+    }
+
+    async flush() {
+        while (this.flushing) {
+            await this.flushing;
+        }
+        const length = this.toBuffer().length;
+        const buffer = this.buffer;
+        this.buffer = this.spareBuffer || Buffer.from(new SharedArrayBuffer(this.bufferSize + 1));
+        this.bufferSize = this.buffer.length - 1;
+        this.spareBuffer = null;
+        this.reset();
+
+        const flushing = postBatch(this, buffer, length).finally(() => {
+            this.spareBuffer = buffer;
+            this.flushing = null;
+        });
+        flushing.catch(() => {});
+        this.flushing = flushing;
+        await flushing;
+    }
+}
+
+function postBatch(builder, buffer, length) {
+    return new Promise((resolve, reject) => {
+        const id = builder.nextId++;
+        if (builder.callbacks.size < 1) {
+            // listen only while waiting for a batch, so the worker can exit when it is done
+            builder.port.on("message", builder.onMessage);
+        }
+        builder.callbacks.set(id, { resolve, reject });
+        builder.port.postMessage({ type: BATCH, id: id, buffer: buffer.buffer, length: length });
+    });
+}
+
+function batchSent(builder, message) {
+    if (!message || message.type !== BATCH_SENT) {
+        return;
+    }
+    const callback = builder.callbacks.get(message.id);
+    if (!callback) {
+        return;
+    }
+    builder.callbacks.delete(message.id);
+    if (builder.callbacks.size < 1) {
+        builder.port.off("message", builder.onMessage);
+    }
+    message.error ? callback.reject(message.error) : callback.resolve();
+}
+
+// Sends the batches flushed by the WorkerBuilder running in the worker via the sender.
+function connectWorker(worker, sender) {
+    worker.on("message", message => {
+        if (!message || message.type !== BATCH) {
+            return;
+        }
+        sender.send(Buffer.from(message.buffer, 0, message.length)).then(
+            () => worker.postMessage({ type: BATCH_SENT, id: message.id }),
+            err => worker.postMessage({ type: BATCH_SENT, id: message.id, error: `${err}` })
+        );
+    });
+}
+
+exports.WorkerBuilder = WorkerBuilder;
+exports.connectWorker = connectWorker;
@@ -0,0 +1,64 @@
+const { Sender, BatchBuilder } = require("../index");
+const { MockProxy } = require("./mockproxy");
+
+// each test file listens on its own port, jest runs the files in parallel
+const PROXY_PORT = 9100;
+const PROXY_HOST = '127.0.0.1';
+
+async function sleep(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+describe('BatchBuilder test suite', function () {
+    it('keeps the rows of each table together', function () {
+        const batch = new BatchBuilder(64);
+        batch.addTable("cpu").addSymbol("host", "a").addFloat("load", 0.5).atNow();
+        batch.addTable("mem").addSymbol("host", "a").addInteger("free", 1024).atNow();
+        batch.addTable("cpu").addSymbol("host", "b").addFloat("load", 0.7).atNow();
+        batch.addTable("mem").addSymbol("host", "b").addInteger("free", 2048).at(1658484765000000000);
+        expect(batch.toBuffers().map(buffer => buffer.toString())).toEqual([
+            "cpu,host=a load=0.5\ncpu,host=b load=0.7\n",
+            "mem,host=a free=1024i\nmem,host=b free=2048i 1658484765000000000\n"
+        ]);
+        expect(batch.position).toBe(104);
+
+        batch.reset();
+        expect(batch.toBuffers()).toEqual([]);
+        batch.addTable("mem").addSymbol("host", "c").atNow();
+        expect(batch.toBuffers().map(buffer => buffer.toString())).toEqual(["mem,host=c\n"]);
+    });
+
+    it('throws exception if a row is not closed', function () {
+        const batch = new BatchBuilder(64);
+        batch.addTable("cpu").addSymbol("host", "a");
+        expect(
+            () => batch.addTable("mem")
+        ).toThrow("Table name has already been set");
+        expect(
+            () => batch.toBuffers()
+        ).toThrow("The builder's content is invalid, row needs to be closed by calling at() or atNow()");
+    });
+
+    it('can flush the tables via the sender in one write', async function () {
+        const proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        const sender = new Sender();
+        expect(await sender.connect(PROXY_PORT, PROXY_HOST)).toBe(true);
+
+        const batch = new BatchBuilder(1024);
+        batch.addTable("cpu").addFloat("load", 0.5).atNow();
+        batch.addTable("mem").addInteger("free", 1024).atNow();
+        batch.addTable("cpu").addFloat("load", 0.7).atNow();
+        const flushed = batch.flush(sender);
+        expect(
+            () => batch.addTable("cpu")
+        ).toThrow("Rows cannot be added while the batch is being flushed");
+        await flushed;
+        expect(batch.position).toBe(0);
+
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe("cpu load=0.5\ncpu load=0.7\nmem free=1024i\n");
+        await sender.close();
+        await proxy.stop();
+    });
+});
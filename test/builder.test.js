@@ -88,6 +88,39 @@ describe('Builder test suite (anything not covered in client interop test suite)
         );
     });
 
+    it('supports bigint timestamps and integers', function () {
+        const builder = new Builder(1024);
+        builder.addTable("tableName")
+            .addInteger("intCol", -9223372036854775807n)
+            .addTimestamp("timestampCol", 1658484765000001n)
+            .at(1658484769000000123n);
+        builder.addTable("tableName")
+            .addInteger("intCol", 9223372036854775807n)
+            .at(-1n);
+        expect(builder.toBuffer().toString()).toBe(
+            "tableName intCol=-9223372036854775807i,timestampCol=1658484765000001t 1658484769000000123\n"
+            + "tableName intCol=9223372036854775807i -1\n"
+        );
+    });
+
+    it('supports setting designated timestamp in different units', function () {
+        const builder = new Builder(1024);
+        builder.addTable("tableName").addBoolean("boolCol", true).atNanos(1658484769000000123n);
+        builder.addTable("tableName").addBoolean("boolCol", true).atMicros(1658484769000001);
+        builder.addTable("tableName").addBoolean("boolCol", true).atMicros(1658484769000001n);
+        builder.addTable("tableName").addBoolean("boolCol", true).atMillis(1658484769001);
+        builder.addTable("tableName").addBoolean("boolCol", true).atMillis(-5);
+        builder.addTable("tableName").addBoolean("boolCol", true).atMillis(0);
+        expect(builder.toBuffer().toString()).toBe(
+            "tableName boolCol=t 1658484769000000123\n"
+            + "tableName boolCol=t 1658484769000001000\n"
+            + "tableName boolCol=t 1658484769000001000\n"
+            + "tableName boolCol=t 1658484769001000000\n"
+            + "tableName boolCol=t -5000000\n"
+            + "tableName boolCol=t 0\n"
+        );
+    });
+
     it('throws exception if table name is not a string', function () {
         const builder = new Builder(1024);
         expect(
@@ -214,7 +247,7 @@ describe('Builder test suite (anything not covered in client interop test suite)
             () => builder.addTable("tableName")
                 .addSymbol("name", "value")
                 .at("34567878")
-        ).toThrow("Timestamp must be a number, received string");
+        ).toThrow("Timestamp must be a number or a bigint, received string");
     });
 
     it('throws exception if designated timestamp is not an integer', function () {
@@ -258,6 +291,208 @@ describe('Builder test suite (anything not covered in client interop test suite)
         );
     });
 
+    it('grows the buffer up to the max buffer size', function () {
+        const builder = new Builder(16, { maxBufferSize: 64 });
+        builder.addTable("tableName")
+            .addInteger("intField", 123)
+            .atNow();
+        expect(builder.bufferSize).toBe(32);
+        builder.addTable("tableName")
+            .addInteger("intField", 456)
+            .atNow();
+        expect(builder.bufferSize).toBe(64);
+        expect(builder.toBuffer().toString()).toBe(
+            "tableName intField=123i\n"
+            + "tableName intField=456i\n"
+        );
+    });
+
+    it('rolls back to the last complete row if the buffer cannot grow more', function () {
+        const builder = new Builder(16, { maxBufferSize: 32 });
+        builder.addTable("tableName")
+            .addInteger("intField", 123)
+            .atNow();
+        expect(
+            () => builder.addTable("tableName")
+                .addInteger("intField", 456)
+        ).toThrow("Buffer overflow [position=33, bufferSize=32]");
+        expect(builder.toBuffer().toString()).toBe(
+            "tableName intField=123i\n"
+        );
+
+        builder.addTable("t")
+            .addBoolean("b", true)
+            .atNow();
+        expect(builder.toBuffer().toString()).toBe(
+            "tableName intField=123i\n"
+            + "t b=t\n"
+        );
+    });
+
+    it('can use a SharedArrayBuffer backed buffer', function () {
+        const builder = new Builder(16, { maxBufferSize: 64, shared: true });
+        expect(builder.buffer.buffer instanceof SharedArrayBuffer).toBe(true);
+        builder.addTable("tableName")
+            .addInteger("intField", 123)
+            .atNow();
+        expect(builder.buffer.buffer instanceof SharedArrayBuffer).toBe(true);
+        expect(builder.toBuffer().toString()).toBe(
+            "tableName intField=123i\n"
+        );
+    });
+
+    it('writes repeated table and column names the same way', function () {
+        const builder = new Builder(1024);
+        for (let i = 0; i < 2; i++) {
+            builder.addTable("table name")
+                .addSymbol("sym bol", "value")
+                .addInteger("int=field", i)
+                .atNow();
+        }
+        expect(builder.toBuffer().toString()).toBe(
+            "table\\ name,sym\\ bol=value int\\=field=0i\n"
+            + "table\\ name,sym\\ bol=value int\\=field=1i\n"
+        );
+        for (let i = 0; i < 2; i++) {
+            expect(
+                () => builder.addTable("tableName")
+                    .addInteger("int.field", i)
+            ).toThrow("Invalid character in column name: .");
+            builder.reset();
+        }
+    });
+
+    it('can compile a row writer for a schema', function () {
+        const builder = new Builder(1024);
+        const writeRow = builder.compile({
+            table: "table name",
+            symbols: ["location", "city"],
+            columns: {
+                note: "string",
+                active: "boolean",
+                temperature: "float",
+                count: "integer",
+                measured: "timestamp"
+            }
+        });
+        writeRow(["emea", "san francisco", "hi, \"there\"", true, 12.5, 3, 1658484765000000], 1658484769000000000);
+        writeRow(["asia", "singapore", "", false, -1.25, -7, 1658484766000000]);
+        expect(builder.toBuffer().toString()).toBe(
+            "table\\ name,location=emea,city=san\\ francisco note=\"hi, \\\"there\\\"\",active=t,temperature=12.5,"
+            + "count=3i,measured=1658484765000000t 1658484769000000000\n"
+            + "table\\ name,location=asia,city=singapore note=\"\",active=f,temperature=-1.25,"
+            + "count=-7i,measured=1658484766000000t\n"
+        );
+    });
+
+    it('can compile a row writer for a schema without symbols or columns', function () {
+        const builder = new Builder(1024);
+        builder.compile({ table: "symbols", symbols: ["a", "b"] })(["x", "y"]);
+        builder.compile({ table: "columns", columns: { a: "integer", b: "string" } })([1, "y"], 1234);
+        expect(builder.toBuffer().toString()).toBe(
+            "symbols,a=x,b=y\n"
+            + "columns a=1i,b=\"y\" 1234\n"
+        );
+    });
+
+    it('discards the row if the compiled writer fails', function () {
+        const builder = new Builder(1024, { protocolVersion: 2 });
+        const writeRow = builder.compile({ table: "trades", symbols: ["pair"], columns: { amount: "integer" } });
+        writeRow(["BTC-USD", 25]);
+        expect(() => writeRow([undefined, 3])).toThrow();
+        const writeArray = builder.compile({ table: "arrays", columns: { values: "array" } });
+        expect(
+            () => writeArray([[[1.1, 2.2], [3.3]]])
+        ).toThrow("Array must be rectangular, dimension 1 should have 2 elements");
+        expect(builder.hasTable).toBe(false);
+        writeRow(["ETH-USD", 3]);
+        expect(builder.toBuffer().toString()).toBe(
+            "trades,pair=BTC-USD amount=25i\n"
+            + "trades,pair=ETH-USD amount=3i\n"
+        );
+    });
+
+    it('throws exception if the schema is invalid', function () {
+        const builder = new Builder(1024);
+        expect(
+            () => builder.compile({ table: "tableName", columns: { a: "double" } })
+        ).toThrow("Unsupported column type: double");
+        expect(
+            () => builder.compile({ table: "tableName" })
+        ).toThrow("The schema must have a symbol or field");
+        expect(
+            () => builder.compile({ table: "tableName", symbols: ["a.b"] })
+        ).toThrow("Invalid character in column name: .");
+    });
+
+    it('formats numbers the same way as toString()', function () {
+        const floats = [0, -0, 1, -1, 0.1, 0.3, 1 / 3, 0.1 + 0.2, 17.1, -1.25, 123456789.123456, 0.999999,
+            0.000001, 1e-7, 99999999999999.9, 1e15, 1e21, 5e-324, Number.MAX_VALUE, NaN, Infinity, -Infinity];
+        const integers = [0, 7, -7, 1234567890, Number.MAX_SAFE_INTEGER, -Number.MAX_SAFE_INTEGER, 2 ** 60, 1e21];
+        const builder = new Builder(4096);
+        for (const value of floats) {
+            builder.addTable("tableName").addFloat("floatField", value).atNow();
+        }
+        for (const value of integers) {
+            builder.addTable("tableName").addInteger("intField", value).at(value);
+        }
+        expect(builder.toBuffer().toString()).toBe(
+            floats.map(value => `tableName floatField=${value.toString()}\n`).join('')
+            + integers.map(value => `tableName intField=${value.toString()}i ${value.toString()}\n`).join('')
+        );
+    });
+
+    it('can append rows from columns', function () {
+        const builder = new Builder(1024);
+        builder.appendColumns("trades", {
+            symbols: { pair: ["BTC-USD", "ETH USD", null] },
+            columns: {
+                price: new Float64Array([20654.3, 1541.2, 0.5]),
+                amount: new BigInt64Array([25n, 3n, 9223372036854775807n]),
+                count: { type: "integer", values: [1, 2, 3] },
+                note: ["a", undefined, "c"],
+                active: [true, false, true],
+                measured: { type: "timestamp", values: [1658484765000000, 1658484765000001n, 0] }
+            },
+            timestamps: new BigInt64Array([1658484765000000000n, 1658484765000001000n, 1658484765000002000n])
+        });
+        builder.appendColumns("symbols", { symbols: { a: ["x", "y"] } });
+        expect(builder.toBuffer().toString()).toBe(
+            "trades,pair=BTC-USD price=20654.3,amount=25i,count=1i,note=\"a\",active=t,measured=1658484765000000t 1658484765000000000\n"
+            + "trades,pair=ETH\\ USD price=1541.2,amount=3i,count=2i,active=f,measured=1658484765000001t 1658484765000001000\n"
+            + "trades price=0.5,amount=9223372036854775807i,count=3i,note=\"c\",active=t,measured=0t 1658484765000002000\n"
+            + "symbols,a=x\n"
+            + "symbols,a=y\n"
+        );
+    });
+
+    it('keeps the rows before an invalid row when appending columns', function () {
+        const builder = new Builder(1024);
+        expect(
+            () => builder.appendColumns("tableName", { columns: { count: { type: "integer", values: [1, 2.5, 3] } } })
+        ).toThrow("Field value must be an integer, received 2.5");
+        expect(builder.toBuffer().toString()).toBe(
+            "tableName count=1i\n"
+        );
+        expect(
+            () => builder.appendColumns("tableName", { symbols: { a: ["x", null] } })
+        ).toThrow("The row must have a symbol or field set before it is closed");
+        expect(builder.toBuffer().toString()).toBe(
+            "tableName count=1i\n"
+            + "tableName,a=x\n"
+        );
+    });
+
+    it('throws exception if the columns have different lengths', function () {
+        const builder = new Builder(1024);
+        expect(
+            () => builder.appendColumns("tableName", { symbols: { a: ["x", "y"] }, columns: { b: [1] } })
+        ).toThrow("All columns must have the same number of values, b has 1 instead of 2");
+        expect(
+            () => builder.appendColumns("tableName", { columns: { b: [1] }, timestamps: [] })
+        ).toThrow("All columns must have the same number of values, timestamps has 0 instead of 1");
+    });
+
     it('is possible to reuse the buffer by calling reset()', function () {
         const builder = new Builder(1024);
         builder.addTable("tableName")
@@ -282,4 +517,147 @@ describe('Builder test suite (anything not covered in client interop test suite)
             "tableName intCol=1234567890i,timestampCol=1658484767000000t\n"
         );
     });
+
+    it('escapes special characters in names and values', function () {
+        const builder = new Builder(1024);
+        builder.addTable("table name")
+            .addSymbol("sym bol", "a b,c=d\\e\nf\rg\"h")
+            .addString("str=ing", "a b,c=d\\e\nf\rg\"h")
+            .atNow();
+        expect(builder.toBuffer().toString()).toBe(
+            "table\\ name,sym\\ bol=a\\ b\\,c\\=d\\\\e\\\nf\\\rg\"h "
+            + "str\\=ing=\"a b,c=d\\\\e\\\nf\\\rg\\\"h\"\n"
+        );
+    });
+
+    it('writes unicode characters as utf8', function () {
+        const builder = new Builder(1024);
+        builder.addTable("tábla")
+            .addSymbol("városok", "Győr, Pécs")
+            .addString("emoji", "😀 \"€\"")
+            .atNow();
+        expect(builder.toBuffer().toString()).toBe(
+            "tábla,városok=Győr\\,\\ Pécs emoji=\"😀 \\\"€\\\"\"\n"
+        );
+    });
+
+    it('throws exception if a multibyte character does not fit into the buffer', function () {
+        const builder = new Builder(16);
+        expect(
+            () => builder.addTable("tableName")
+                .addString("s", "x😀")
+        ).toThrow("Buffer overflow [position=18, bufferSize=16]");
+    });
+
+    it('writes floats in binary with protocol version 2', function () {
+        const builder = new Builder(1024, { protocolVersion: 2 });
+        builder.addTable("tableName")
+            .addSymbol("sym", "x")
+            .addFloat("f", 17.1)
+            .addInteger("i", 1)
+            .atNow();
+        const double = Buffer.alloc(8);
+        double.writeDoubleLE(17.1);
+        expect(builder.toBuffer()).toEqual(Buffer.concat([
+            Buffer.from("tableName,sym=x f=="), Buffer.from([16]), double, Buffer.from(",i=1i\n")
+        ]));
+
+        builder.reset();
+        const write = builder.compile({ table: "tableName", columns: { f: "float" } });
+        write([17.1]);
+        expect(builder.toBuffer()).toEqual(Buffer.concat([Buffer.from("tableName f=="), Buffer.from([16]), double, Buffer.from("\n")]));
+    });
+
+    it('writes arrays in binary with protocol version 2', function () {
+        const elements = values => {
+            const buffer = Buffer.alloc(values.length * 8);
+            values.forEach((value, i) => buffer.writeDoubleLE(value, i * 8));
+            return buffer;
+        };
+        const int32 = value => {
+            const buffer = Buffer.alloc(4);
+            buffer.writeInt32LE(value);
+            return buffer;
+        };
+        const builder = new Builder(16, { protocolVersion: 2, maxBufferSize: 1024 });
+        builder.addTable("tableName")
+            .addArray("a", [[1.1, 2.2, 3.3], [4.4, 5.5, 6.6]])
+            .addArray("b", new Float64Array([-1, 0.5]))
+            .addArray("c", [])
+            .atNow();
+        expect(builder.toBuffer()).toEqual(Buffer.concat([
+            Buffer.from("tableName a=="), Buffer.from([14, 10, 2]), int32(2), int32(3), elements([1.1, 2.2, 3.3, 4.4, 5.5, 6.6]),
+            Buffer.from(",b=="), Buffer.from([14, 10, 1]), int32(2), elements([-1, 0.5]),
+            Buffer.from(",c=="), Buffer.from([14, 10, 1]), int32(0),
+            Buffer.from("\n")
+        ]));
+
+        builder.reset();
+        builder.appendColumns("tableName", { columns: { a: [[1.1], new Float64Array([2.2])] } });
+        expect(builder.toBuffer()).toEqual(Buffer.concat([
+            Buffer.from("tableName a=="), Buffer.from([14, 10, 1]), int32(1), elements([1.1]), Buffer.from("\n"),
+            Buffer.from("tableName a=="), Buffer.from([14, 10, 1]), int32(1), elements([2.2]), Buffer.from("\n")
+        ]));
+    });
+
+    it('throws exception if the array is invalid', function () {
+        expect(
+            () => new Builder(1024).addTable("tableName").addArray("a", [1.1])
+        ).toThrow("Arrays are supported only with protocol version 2");
+        const builder = new Builder(1024, { protocolVersion: 2 });
+        expect(
+            () => builder.addTable("tableName").addArray("a", [[1.1, 2.2], [3.3]])
+        ).toThrow("Array must be rectangular, dimension 1 should have 2 elements");
+        expect(
+            () => builder.addArray("a", [[1.1], [[3.3]]])
+        ).toThrow("Array elements must be numbers, received array");
+        expect(
+            () => builder.addArray("a", ["x"])
+        ).toThrow("Array elements must be numbers, received string");
+        expect(
+            () => builder.addArray("a", "x")
+        ).toThrow("Array value must be an array or a Float64Array, received string");
+        expect(
+            () => new Builder(1024, { protocolVersion: 3 })
+        ).toThrow("Unsupported protocol version: 3");
+    });
+
+    it('caches the escaped bytes of the most recently used symbol values', function () {
+        const builder = new Builder(1024, { symbolCacheSize: 2 });
+        builder.addTable("tableName").addSymbol("city", "New York").addSymbol("code", 1).atNow();
+        builder.addTable("tableName").addSymbol("city", "New York").addSymbol("code", 2).atNow();
+        expect(Array.from(builder.symbolCache.keys())).toEqual(["New York", "2"]);
+        builder.addTable("tableName").addSymbol("city", "Győr, HU").atNow();
+        expect(Array.from(builder.symbolCache.keys())).toEqual(["2", "Győr, HU"]);
+        builder.addTable("tableName").addSymbol("city", "Győr, HU").atNow();
+
+        const write = builder.compile({ table: "tableName", symbols: ["city"] });
+        write(["New York"]);
+        builder.appendColumns("tableName", { symbols: { city: ["2", "Győr, HU"] } });
+        expect(Array.from(builder.symbolCache.keys())).toEqual(["2", "Győr, HU"]);
+        expect(builder.toBuffer().toString()).toBe(
+            "tableName,city=New\\ York,code=1\n"
+            + "tableName,city=New\\ York,code=2\n"
+            + "tableName,city=Győr\\,\\ HU\n"
+            + "tableName,city=Győr\\,\\ HU\n"
+            + "tableName,city=New\\ York\n"
+            + "tableName,city=2\n"
+            + "tableName,city=Győr\\,\\ HU\n"
+        );
+    });
+
+    it('can roll back the row being added', function () {
+        const builder = new Builder(1024);
+        builder.addTable("tableName").addSymbol("sym", "a").addInteger("id", 1).atNow();
+        builder.addTable("tableName").addSymbol("sym", "b");
+        expect(
+            () => builder.addFloat("float", "1.1")
+        ).toThrow("Field value must be a number, received string");
+        builder.rollback();
+        builder.addTable("tableName").addSymbol("sym", "c").addInteger("id", 3).atNow();
+        expect(builder.rollback().toBuffer().toString()).toBe(
+            "tableName,sym=a id=1i\n"
+            + "tableName,sym=c id=3i\n"
+        );
+    });
 });
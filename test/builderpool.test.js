@@ -0,0 +1,74 @@
+const { Sender, BuilderPool } = require("../index");
+const { MockProxy } = require("./mockproxy");
+
+// each test file listens on its own port, jest runs the files in parallel
+const PROXY_PORT = 9101;
+const PROXY_HOST = '127.0.0.1';
+
+async function sleep(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+describe('BuilderPool test suite', function () {
+    it('reuses the released builders', function () {
+        const pool = new BuilderPool(1024, { maxPooled: 1, maxBufferSize: 4096 });
+        const first = pool.acquire();
+        const second = pool.acquire();
+        expect(first).not.toBe(second);
+        expect(first.allocUnsafe).toBe(true);
+        expect(first.maxBufferSize).toBe(4096);
+
+        first.addTable("test").addInteger("id", 1).atNow();
+        pool.release(first);
+        pool.release(first);
+        pool.release(second);
+        expect(pool.size).toBe(1);
+
+        const reused = pool.acquire();
+        expect(reused).toBe(first);
+        expect(reused.position).toBe(0);
+        reused.addTable("test").addInteger("id", 2).atNow();
+        expect(reused.toBuffer().toString()).toBe("test id=2i\n");
+        expect(pool.size).toBe(0);
+    });
+
+    it('releases the builder when it has been sent', async function () {
+        const proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        const sender = new Sender();
+        expect(await sender.connect(PROXY_PORT, PROXY_HOST)).toBe(true);
+
+        const pool = new BuilderPool(1024);
+        const builder = pool.acquire();
+        builder.addTable("test").addInteger("id", 1).atNow();
+        const sent = pool.send(sender, builder);
+        expect(pool.size).toBe(0);
+        await sent;
+        expect(pool.size).toBe(1);
+        expect(pool.acquire()).toBe(builder);
+
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe("test id=1i\n");
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('keeps the rows of the builder if the send fails', async function () {
+        const pool = new BuilderPool(1024);
+        const builder = pool.acquire();
+        builder.addTable("test").addInteger("id", 1).atNow();
+        builder.addTable("test").addInteger("id", 2);
+        const sender = {
+            send: async () => {
+                throw "write failed";
+            }
+        };
+        await expect(pool.send(sender, builder)).rejects.toThrow(
+            "The builder's content is invalid, row needs to be closed by calling at() or atNow()"
+        );
+        builder.atNow();
+        await expect(pool.send(sender, builder)).rejects.toThrow("write failed");
+        expect(pool.size).toBe(0);
+        expect(builder.toBuffer().toString()).toBe("test id=1i\ntest id=2i\n");
+    });
+});
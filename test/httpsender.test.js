@@ -0,0 +1,199 @@
+const http = require("http");
+const zlib = require("zlib");
+const { HttpSender, BatchBuilder } = require("../index");
+
+// each test file listens on its own port, jest runs the files in parallel
+const PORT = 9102;
+const HOST = '127.0.0.1';
+
+async function sleep(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+// records the requests, responds with the status returned by the handler
+async function createServer(handler = () => 204, settings = null) {
+    const server = { requests: [], inFlight: 0, maxInFlight: 0, sockets: new Set() };
+    server.http = http.createServer((req, res) => {
+        if (req.method === "GET" && req.url === "/settings") {
+            res.writeHead(settings ? 200 : 404, { "Content-Type": "application/json" });
+            res.end(JSON.stringify(settings || {}));
+            return;
+        }
+        server.inFlight++;
+        server.maxInFlight = Math.max(server.maxInFlight, server.inFlight);
+        const chunks = [];
+        req.on("data", chunk => chunks.push(chunk));
+        req.on("end", async () => {
+            let body = Buffer.concat(chunks);
+            if (req.headers["content-encoding"] === "gzip") {
+                body = zlib.gunzipSync(body);
+            }
+            const request = { url: req.url, headers: req.headers, raw: body, body: body.toString() };
+            server.requests.push(request);
+            const status = await handler(request);
+            server.inFlight--;
+            if (status === 204) {
+                res.writeHead(204);
+                res.end();
+            } else {
+                res.writeHead(status, { "Content-Type": "application/json" });
+                res.end(JSON.stringify({ code: "invalid", message: "failed to parse line protocol", line: 2 }));
+            }
+        });
+    });
+    server.http.on("connection", socket => {
+        server.sockets.add(socket);
+        socket.on("close", () => server.sockets.delete(socket));
+    });
+    await new Promise(resolve => server.http.listen(PORT, HOST, resolve));
+    server.stop = () => {
+        for (const socket of server.sockets) {
+            socket.destroy();
+        }
+        return new Promise(resolve => server.http.close(resolve));
+    };
+    return server;
+}
+
+describe('HttpSender test suite', function () {
+    it('posts the rows to the write endpoint', async function () {
+        const server = await createServer();
+        const sender = new HttpSender({ token: "secret" });
+        expect(await sender.connect(PORT, HOST)).toBe(true);
+        sender.addTable("test").addSymbol("location", "us").addFloat("temperature", 17.1).at(1658484765000000000);
+        sender.addTable("test").addSymbol("location", "eu").addFloat("temperature", 18.2).at(1658484765000000000);
+        await sender.flush();
+        sender.addTable("test").addInteger("id", 1).atNow();
+        await sender.close();
+
+        expect(server.requests.length).toBe(2);
+        expect(server.requests[0].url).toBe("/write?precision=n");
+        expect(server.requests[0].headers.authorization).toBe("Bearer secret");
+        expect(server.requests[0].body).toBe("test,location=us temperature=17.1 1658484765000000000\n"
+            + "test,location=eu temperature=18.2 1658484765000000000\n");
+        expect(server.requests[1].body).toBe("test id=1i\n");
+        // the connection is kept alive
+        expect(server.requests[1].headers.connection).toBe("keep-alive");
+        await server.stop();
+    });
+
+    it('keeps the buffered rows if flushed while a row is being added', async function () {
+        const server = await createServer();
+        const sender = new HttpSender();
+        await sender.connect(PORT, HOST);
+        sender.addTable("test").addInteger("id", 1).atNow();
+        sender.addTable("test").addInteger("id", 2).atNow();
+        sender.addTable("test").addInteger("id", 3);
+        await expect(sender.flush()).rejects.toThrow(
+            "The builder's content is invalid, row needs to be closed by calling at() or atNow()"
+        );
+        expect(sender.pendingRows).toBe(2);
+        sender.atNow();
+        await sender.close();
+
+        expect(server.requests.map(request => request.body)).toEqual(["test id=1i\ntest id=2i\ntest id=3i\n"]);
+        await server.stop();
+    });
+
+    it('reports the error returned by the server', async function () {
+        const server = await createServer(() => 400);
+        const sender = new HttpSender({ username: "admin", password: "quest" });
+        await sender.connect(PORT, HOST);
+        sender.addTable("test").addInteger("id", 1).atNow();
+        let error;
+        await sender.flush().catch(err => error = err);
+        expect(error).toBe("HTTP request failed [status=400, message=failed to parse line protocol, line 2]");
+        expect(server.requests[0].headers.authorization).toBe(`Basic ${Buffer.from("admin:quest").toString("base64")}`);
+
+        error = undefined;
+        await sender.send("test id=2i\n").catch(err => error = err);
+        expect(error).toBe("HTTP request failed [status=400, message=failed to parse line protocol, line 2]");
+        await sender.close();
+        await server.stop();
+    });
+
+    it('compresses large batches and limits the number of requests in flight', async function () {
+        const server = await createServer(async () => {
+            await sleep(50);
+            return 204;
+        });
+        const sender = new HttpSender({
+            autoFlush: true,
+            autoFlushRows: 10,
+            maxConcurrentRequests: 2,
+            gzip: true,
+            gzipMinSize: 100
+        });
+        await sender.connect(PORT, HOST);
+        let expected = "";
+        for (let i = 0; i < 55; i++) {
+            await sender.addTable("test").addInteger("id", i).atNow();
+            expected += `test id=${i}i\n`;
+        }
+        await sender.flush();
+
+        expect(server.requests.length).toBe(6);
+        expect(server.maxInFlight).toBe(2);
+        // the last batch of 5 rows is below gzipMinSize
+        const compressed = server.requests.filter(request => request.headers["content-encoding"] === "gzip");
+        expect(compressed.length).toBe(5);
+        expect(compressed[0].headers["transfer-encoding"]).toBe("chunked");
+        expect(server.requests.map(request => request.body).sort().join("").split("\n").sort())
+            .toEqual(expected.split("\n").sort());
+        expect(sender.spareBuilders.length).toBeLessThanOrEqual(2);
+        await sender.close();
+        await server.stop();
+    });
+
+    it('flushes automatically when the flush interval elapses', async function () {
+        const server = await createServer();
+        const sender = new HttpSender({ autoFlush: true, autoFlushRows: 100, autoFlushInterval: 100 });
+        await sender.connect(PORT, HOST);
+        await sender.addTable("test").addInteger("id", 1).atNow();
+        expect(server.requests.length).toBe(0);
+        await sleep(500);
+        expect(server.requests.map(request => request.body)).toEqual(["test id=1i\n"]);
+        expect(sender.pendingRows).toBe(0);
+        await sender.close();
+        await server.stop();
+    });
+
+    it('posts the tables of a batch in one request', async function () {
+        const server = await createServer();
+        const sender = new HttpSender();
+        await sender.connect(PORT, HOST);
+        const batch = new BatchBuilder(1024);
+        batch.addTable("cpu").addFloat("load", 0.5).atNow();
+        batch.addTable("mem").addInteger("free", 1024).atNow();
+        batch.addTable("cpu").addFloat("load", 0.7).atNow();
+        await batch.flush(sender);
+        expect(batch.position).toBe(0);
+        expect(server.requests.map(request => request.body)).toEqual(["cpu load=0.5\ncpu load=0.7\nmem free=1024i\n"]);
+        await sender.close();
+        await server.stop();
+    });
+
+    it('negotiates the protocol version with the server', async function () {
+        const server = await createServer(() => 204, { config: { "line.proto.support.versions": [1, 2] } });
+        const sender = new HttpSender({ protocolVersion: "auto" });
+        await sender.connect(PORT, HOST);
+        expect(sender.protocolVersion).toBe(2);
+        sender.addTable("test").addFloat("f", 1.5).atNow();
+        await sender.flush();
+        const double = Buffer.alloc(8);
+        double.writeDoubleLE(1.5);
+        expect(server.requests[0].raw).toEqual(Buffer.concat([Buffer.from("test f=="), Buffer.from([16]), double, Buffer.from("\n")]));
+        await sender.close();
+        await server.stop();
+
+        const oldServer = await createServer();
+        const oldSender = new HttpSender({ protocolVersion: "auto" });
+        await oldSender.connect(PORT, HOST);
+        expect(oldSender.protocolVersion).toBe(1);
+        oldSender.addTable("test").addFloat("f", 1.5).atNow();
+        await oldSender.flush();
+        expect(oldServer.requests[0].body).toBe("test f=1.5\n");
+        await oldSender.close();
+        await oldServer.stop();
+    });
+});
@@ -0,0 +1,65 @@
+const { Builder } = require("../index");
+const { native } = require("../src/native");
+
+const ALPHABET = ['a', 'Z', '0', ' ', ',', '=', '"', '\n', '\r', '\\', '\t', 'é', '€', '😀', '_'];
+
+function randomString(random, length) {
+    let str = "";
+    for (let i = 0; i < length; i++) {
+        str += ALPHABET[Math.floor(random() * ALPHABET.length)];
+    }
+    return str;
+}
+
+// deterministic pseudo-random numbers, so failures can be reproduced
+function createRandom(seed) {
+    return () => {
+        seed = (seed * 1103515245 + 12345) % 2147483648;
+        return seed / 2147483648;
+    };
+}
+
+const itIfNative = native ? it : it.skip;
+
+describe('Native encoder test suite', function () {
+    itIfNative('escapes strings the same way as the JS implementation', function () {
+        const random = createRandom(42);
+        for (let i = 0; i < 1000; i++) {
+            const value = randomString(random, 32 + Math.floor(random() * 200));
+            for (const quoted of [false, true]) {
+                const buffer = Buffer.alloc(4096);
+                const position = native.writeEscaped(buffer, 0, 4096, value, value.length, quoted);
+
+                let expected = "";
+                for (const ch of value) {
+                    if ((!quoted && (ch === ' ' || ch === ',' || ch === '='))
+                        || (quoted && ch === '"')
+                        || ch === '\n' || ch === '\r' || ch === '\\') {
+                        expected += '\\';
+                    }
+                    expected += ch;
+                }
+                expect(buffer.subarray(0, position).toString()).toBe(expected);
+            }
+        }
+    });
+
+    itIfNative('returns -1 if the escaped string does not fit', function () {
+        const value = "a,".repeat(20);
+        const buffer = Buffer.alloc(128);
+        expect(native.writeEscaped(buffer, 10, 69, value, value.length, false)).toBe(-1);
+        expect(native.writeEscaped(buffer, 10, 70, value, value.length, false)).toBe(70);
+    });
+
+    it('produces the same output with or without the native encoder', function () {
+        const value = "some long value, with \"quotes\" and spaces = 😀 ".repeat(3);
+        const builder = new Builder(16, { maxBufferSize: 1024 });
+        builder.addTable("tableName")
+            .addSymbol("sym", value)
+            .addString("str", value)
+            .atNow();
+        const escaped = value.replace(/[ ,=]/g, ch => `\\${ch}`);
+        const quoted = value.replace(/"/g, '\\"');
+        expect(builder.toBuffer().toString()).toBe(`tableName,sym=${escaped} str="${quoted}"\n`);
+    });
+});
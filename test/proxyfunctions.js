@@ -25,6 +25,9 @@ async function listen(proxy, listenPort, dataHandler) {
 
             client.on("close", async () => {
                 console.log("client connection closed");
+                if (proxy.client === client) {
+                    proxy.client = null;
+                }
             });
         });
 
@@ -25,8 +25,8 @@ async function createProxy(mockConfig = { "auth": true, "assertions": true }) {
     return proxy;
 }
 
-async function createSender(jwk = null) {
-    const sender = new Sender(jwk);
+async function createSender(jwk = null, options = {}) {
+    const sender = new Sender(jwk, options);
     const connected = await sender.connect(PROXY_PORT, PROXY_HOST);
     expect(connected).toBe(true);
     return sender;
@@ -97,4 +97,367 @@ describe('Sender test suite', function () {
         await assertSentData(proxy, false, "test,location=us temperature=17.1 1658484765000000000\n");
         await proxy.stop();
     });
+    it('can add rows to the sender and flush them', async function () {
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender();
+        await sender.addTable("test")
+            .addSymbol("location", "us")
+            .addFloat("temperature", 17.1)
+            .at(1658484765000000000);
+        await sender.addTable("test")
+            .addSymbol("location", "gb")
+            .addFloat("temperature", 12.4)
+            .at(1658484766000000000);
+        await sender.flush();
+        expect(await assertSentData(proxy, false, "test,location=us temperature=17.1 1658484765000000000\n"
+            + "test,location=gb temperature=12.4 1658484766000000000\n")).toBe(null);
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('flushes automatically when the number of rows reaches the threshold', async function () {
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender(null, { autoFlush: true, autoFlushRows: 2, autoFlushInterval: 0 });
+        await sender.addTable("test").addInteger("id", 1).atNow();
+        await sleep(200);
+        expect(proxy.getDataSentToRemote()).toStrictEqual([]);
+        await sender.addTable("test").addInteger("id", 2).atNow();
+        expect(await assertSentData(proxy, false, "test id=1i\ntest id=2i\n")).toBe(null);
+        expect(sender.pendingRows).toBe(0);
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('flushes automatically when the buffered data reaches the size threshold', async function () {
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender(null, { autoFlush: true, autoFlushRows: 0, autoFlushBytes: 20, autoFlushInterval: 0 });
+        await sender.addTable("test").addInteger("id", 1).atNow();
+        expect(sender.pendingRows).toBe(1);
+        await sender.addTable("test").addInteger("id", 2).atNow();
+        expect(await assertSentData(proxy, false, "test id=1i\ntest id=2i\n")).toBe(null);
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('flushes automatically when the flush interval elapses', async function () {
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender(null, { autoFlush: true, autoFlushRows: 100, autoFlushInterval: 100 });
+        await sender.addTable("test").addInteger("id", 1).atNow();
+        expect(proxy.getDataSentToRemote()).toStrictEqual([]);
+        expect(await assertSentData(proxy, false, "test id=1i\n", 2000)).toBe(null);
+        expect(sender.pendingRows).toBe(0);
+        await sender.close();
+        await proxy.stop();
+    });
+    it('adds rows into the spare buffer while a flush is in progress', async function () {
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender(null, { autoFlush: true, autoFlushRows: 1, autoFlushInterval: 0 });
+        const builder = sender.builder;
+        const first = sender.addTable("test").addInteger("id", 1).atNow();
+        expect(sender.flushing).toBeTruthy();
+        expect(sender.builder).not.toBe(builder);
+        const second = sender.addTable("test").addInteger("id", 2).atNow();
+        expect(sender.builder.toBuffer().toString()).toBe("test id=2i\n");
+        await Promise.all([first, second]);
+        await sender.flush();
+        expect(await assertSentData(proxy, false, "test id=1i\ntest id=2i\n")).toBe(null);
+        await sender.close();
+        await proxy.stop();
+    });
+    it('can send the buffers of multiple builders in one write', async function () {
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender(null, { reconnect: true });
+        const builders = ["cpu", "mem", "disk"].map(table => {
+            const builder = new Builder(1024);
+            builder.addTable(table).addInteger("id", 1).atNow();
+            return builder;
+        });
+        let calls = 0;
+        const writev = sender.socket._writev;
+        sender.socket._writev = function (chunks, callback) {
+            calls++;
+            return writev.call(this, chunks, callback);
+        };
+        await sender.sendMany(builders.map(builder => builder.toBuffer()));
+        expect(calls).toBe(1);
+        expect(sender.replayQueue.length).toBe(0);
+        expect(await assertSentData(proxy, false, "cpu id=1i\nmem id=1i\ndisk id=1i\n")).toBe(null);
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('fails the send if the connection has been reset', async function () {
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender();
+        const errors = [];
+        sender.on("error", err => errors.push(err));
+        await sleep(100);
+        proxy.client.resetAndDestroy();
+        await sleep(100);
+        await expect(sender.send("test id=1i\n")).rejects.toThrow("Write failed");
+        expect(sender.socket.destroyed).toBe(true);
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('collects stats and publishes flushes to the diagnostics channel', async function () {
+        const diagnostics = require("diagnostics_channel");
+        const flushes = [];
+        const onFlush = message => flushes.push(message);
+        diagnostics.subscribe("questdb:sender:flush", onFlush);
+
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender();
+        sender.addTable("test").addInteger("id", 1).atNow();
+        sender.addTable("test").addInteger("id", 2).atNow();
+        await sender.flush();
+        sender.addTable("test").addInteger("id", 3).atNow();
+        expect(sender.getStats().pendingRows).toBe(1);
+        await sender.flush();
+        diagnostics.unsubscribe("questdb:sender:flush", onFlush);
+
+        const stats = sender.getStats();
+        expect(stats.rowsSent).toBe(3);
+        expect(stats.bytesSent).toBe(33);
+        expect(stats.pendingRows).toBe(0);
+        expect(stats.flushes).toBe(2);
+        expect(stats.failedFlushes).toBe(0);
+        expect(stats.flushLatency.count).toBe(2);
+        expect(stats.flushLatency.max).toBeGreaterThanOrEqual(stats.flushLatency.min);
+        expect(stats.reconnects).toBe(0);
+        expect(stats.backpressureWaits).toBe(0);
+        expect(flushes.map(message => [message.sender, message.rows, message.bytes]))
+            .toEqual([[sender, 2, 22], [sender, 1, 11]]);
+        expect(await assertSentData(proxy, false, "test id=1i\ntest id=2i\ntest id=3i\n")).toBe(null);
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('completes pipelined flushes in order with sequence numbers', async function () {
+        const diagnostics = require("diagnostics_channel");
+        const sequences = [];
+        const onFlush = message => sequences.push(message.sequence);
+        diagnostics.subscribe("questdb:sender:flush", onFlush);
+
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender(null, { maxPendingFlushes: 3 });
+        const completed = [];
+        const flushes = [];
+        for (let i = 1; i <= 3; i++) {
+            sender.addTable("test").addInteger("id", i).atNow();
+            flushes.push(sender.flush().then(() => completed.push(i)));
+        }
+        expect(sender.getStats().pendingFlushes).toBe(3);
+        await Promise.all(flushes);
+        sender.addTable("test").addInteger("id", 4).atNow();
+        expect(await sender.flush()).toBe(4);
+        diagnostics.unsubscribe("questdb:sender:flush", onFlush);
+
+        expect(completed).toEqual([1, 2, 3]);
+        expect(sequences).toEqual([1, 2, 3, 4]);
+        const stats = sender.getStats();
+        expect(stats.lastSequence).toBe(4);
+        expect(stats.completedSequence).toBe(4);
+        expect(stats.pendingFlushes).toBe(0);
+        expect(stats.flushes).toBe(4);
+        expect(stats.queueLatency.count).toBe(4);
+        expect(stats.wireLatency.count).toBe(4);
+        expect(Math.abs(stats.queueLatency.sum + stats.wireLatency.sum - stats.flushLatency.sum)).toBeLessThan(0.001);
+        expect(sender.spareBuilders.length).toBeLessThanOrEqual(3);
+        expect(await assertSentData(proxy, false, "test id=1i\ntest id=2i\ntest id=3i\ntest id=4i\n")).toBe(null);
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('waits for the socket to drain when the high water mark is reached', async function () {
+        const proxy = await createProxy({ auth: false, assertions: false });
+        const sender = await createSender(null, { highWaterMark: 1024 });
+        await sleep(100);
+        proxy.client.pause();
+
+        // the writes fail when the socket is destroyed by close()
+        sender.send(Buffer.alloc(16777216, "a")).catch(() => {});
+        expect(sender.queuedBytes).toBeGreaterThan(1024);
+        let sent = false;
+        sender.send("test id=1i\n").then(() => sent = true, () => {});
+        await sleep(200);
+        expect(sent).toBe(false);
+        expect(sender.queuedBytes).toBeGreaterThan(0);
+
+        await sender.close();
+        proxy.client.destroy();
+        await proxy.stop();
+    });
+    it('reconnects and replays the data sent while disconnected', async function () {
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender(null, { reconnect: true, reconnectInitialDelay: 50 });
+        let reconnected = false;
+        sender.on("reconnect", () => reconnected = true);
+        await sender.send("test id=1i\n");
+        expect(await assertSentData(proxy, false, "test id=1i\n")).toBe(null);
+
+        proxy.client.destroy();
+        await sleep(20);
+        await sender.send("test id=2i\n");
+        expect(reconnected).toBe(true);
+        expect(sender.replayQueueBytes).toBe(0);
+        expect(sender.getStats().reconnects).toBe(1);
+        expect(await assertSentData(proxy, false, "test id=1i\ntest id=2i\n")).toBe(null);
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('can send data before the challenge is signed if the handshake is pipelined', async function () {
+        const crypto = require("crypto");
+        const createPrivateKey = crypto.createPrivateKey;
+        let keysParsed = 0;
+        crypto.createPrivateKey = options => {
+            keysParsed++;
+            return createPrivateKey(options);
+        };
+        const jwk = { ...JWK };
+        try {
+            for (let i = 1; i <= 2; i++) {
+                const proxy = await createProxy();
+                const sender = await createSender(jwk, { pipelineAuth: true });
+                await sender.send(`test id=${i}i\n`);
+                expect(sender.authenticating).toBe(null);
+                expect(await assertSentData(proxy, true, `testapp\ntest id=${i}i\n`)).toBe(null);
+                await sender.close();
+                await proxy.stop();
+            }
+        } finally {
+            crypto.createPrivateKey = createPrivateKey;
+        }
+        // the key is parsed only once
+        expect(keysParsed).toBe(1);
+    });
+
+    it('can authenticate if the challenge is received in multiple chunks', async function () {
+        const net = require("net");
+        const received = [];
+        const server = net.createServer(socket => {
+            socket.on("data", async data => {
+                received.push(data.toString());
+                if (received.length === 1) {
+                    socket.write("a".repeat(100));
+                    await sleep(50);
+                    socket.write("a".repeat(100) + "\n");
+                }
+            });
+        });
+        await new Promise(resolve => server.listen(PROXY_PORT, PROXY_HOST, resolve));
+        const sender = await createSender(JWK);
+        await sender.send("test id=1i\n");
+        await sleep(100);
+        const data = received.join('').split('\n');
+        expect(data[0]).toBe("testapp");
+        expect(data[1].length).toBeGreaterThan(0);
+        expect(data[2]).toBe("test id=1i");
+        await sender.close();
+        await new Promise(resolve => server.close(resolve));
+    });
+
+    it('can authenticate again after reconnecting', async function () {
+        const proxy = await createProxy();
+        const sender = await createSender(JWK, { reconnect: true, reconnectInitialDelay: 50 });
+        await sleep(100);
+        const reconnected = new Promise(resolve => sender.once("reconnect", resolve));
+        proxy.hasSentChallenge = false;
+        proxy.client.destroy();
+        await reconnected;
+        await sender.send("test id=1i\n");
+        await sleep(100);
+        const data = proxy.getDataSentToRemote().join('').split('\n');
+        expect(data[0]).toBe("testapp");
+        expect(data[2]).toBe("testapp");
+        expect(data[4]).toBe("test id=1i");
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('can connect over TLS and resume the session when reconnecting', async function () {
+        const tls = require("tls");
+        const fs = require("fs");
+        const path = require("path");
+        const cert = fs.readFileSync(path.join(__dirname, "certs/server.crt"));
+        const received = [];
+        const sockets = [];
+        const server = tls.createServer({ key: fs.readFileSync(path.join(__dirname, "certs/server.key")), cert: cert }, socket => {
+            sockets.push(socket);
+            socket.on("data", data => received.push(data.toString()));
+            socket.on("error", () => {});
+        });
+        await new Promise(resolve => server.listen(PROXY_PORT, PROXY_HOST, resolve));
+
+        const sender = await createSender(null, {
+            tls: true,
+            tlsOptions: { ca: cert },
+            ciphers: "TLS_AES_256_GCM_SHA384:ECDHE-RSA-AES256-GCM-SHA384",
+            reconnect: true,
+            reconnectInitialDelay: 50
+        });
+        expect(sender.socket.encrypted).toBe(true);
+        expect(sender.socket.isSessionReused()).toBe(false);
+        await sender.send("test id=1i\n");
+        await sleep(100);
+
+        const reconnected = new Promise(resolve => sender.once("reconnect", resolve));
+        sockets[0].destroy();
+        await reconnected;
+        expect(sender.socket.isSessionReused()).toBe(true);
+        await sender.send("test id=2i\n");
+        await sleep(100);
+        expect(received.join("")).toBe("test id=1i\ntest id=2i\n");
+
+        await sender.close();
+        for (const socket of sockets) {
+            socket.destroy();
+        }
+        await new Promise(resolve => server.close(resolve));
+    });
+
+    it('sends the host name for SNI over TLS', async function () {
+        const tls = require("tls");
+        const fs = require("fs");
+        const path = require("path");
+        const cert = fs.readFileSync(path.join(__dirname, "certs/server.crt"));
+        const servernames = [];
+        const server = tls.createServer({ key: fs.readFileSync(path.join(__dirname, "certs/server.key")), cert: cert }, socket => {
+            servernames.push(socket.servername);
+            socket.on("error", () => {});
+        });
+        await new Promise(resolve => server.listen(PROXY_PORT, PROXY_HOST, resolve));
+
+        const named = new Sender(null, { tls: true, tlsOptions: { ca: cert } });
+        expect(await named.connect(PROXY_PORT, "localhost")).toBe(true);
+        const address = new Sender(null, { tls: true, tlsOptions: { ca: cert } });
+        expect(await address.connect(PROXY_PORT, PROXY_HOST)).toBe(true);
+        await sleep(100);
+        // no SNI is sent for IP addresses
+        expect(servernames).toEqual(["localhost", false]);
+
+        await named.close();
+        await address.close();
+        await new Promise(resolve => server.close(resolve));
+    });
+
+    it('rejects queued data if it cannot reconnect', async function () {
+        const proxy = await createProxy({ auth: false, assertions: true });
+        const sender = await createSender(null, {
+            reconnect: true, reconnectInitialDelay: 20, reconnectMaxRetries: 2, replayQueueSize: 16
+        });
+        let error;
+        sender.on("error", err => error = err);
+        await sleep(100);
+        proxy.client.destroy();
+        await proxy.stop();
+        await sleep(20);
+        const sent = sender.send("test id=1i\n");
+        await expect(
+            sender.send("test id=2i\n")
+        ).rejects.toThrow("Replay queue is full [queued=11, replayQueueSize=16]");
+        await expect(sent).rejects.toThrow("Could not reconnect to 127.0.0.1:9099 after 2 attempts");
+        expect(error).toBe("Could not reconnect to 127.0.0.1:9099 after 2 attempts");
+    });
 });
@@ -0,0 +1,189 @@
+const { SenderPool } = require("../index");
+const { MockProxy } = require("./mockproxy");
+
+// each test file listens on its own ports, jest runs the files in parallel
+const PROXY_PORTS = [9103, 9104];
+const PROXY_HOST = '127.0.0.1';
+const UNUSED_PORT = 9105;
+
+async function createProxies(mockConfig = { "auth": false, "assertions": true }) {
+    const proxies = [];
+    for (const port of PROXY_PORTS) {
+        const proxy = new MockProxy(mockConfig);
+        await proxy.start(port);
+        proxies.push(proxy);
+    }
+    return proxies;
+}
+
+async function stopProxies(proxies) {
+    for (const proxy of proxies) {
+        await proxy.stop();
+    }
+}
+
+async function createPool(ports = PROXY_PORTS, options = {}) {
+    const pool = new SenderPool(null, options);
+    const connected = await pool.connect(ports.map(port => ({ port: port, host: PROXY_HOST })));
+    expect(connected).toBe(true);
+    return pool;
+}
+
+async function assertSentData(proxy, expected, timeout = 5000) {
+    const interval = 100;
+    const num = timeout / interval;
+    let actual;
+    for (let i = 0; i < num; i++) {
+        actual = proxy.getDataSentToRemote().join('');
+        if (actual === expected) {
+            return null;
+        }
+        await sleep(interval);
+    }
+    return `data assert failed [expected=${expected}, actual=${actual}]`;
+}
+
+async function sleep(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+describe('SenderPool test suite', function () {
+    it('spreads batches across the connections', async function () {
+        const proxies = await createProxies();
+        const pool = await createPool();
+        expect(pool.size).toBe(2);
+        await pool.send("test id=1i\n");
+        await pool.send("test id=2i\n");
+        await pool.send("test id=3i\n");
+        expect(await assertSentData(proxies[0], "test id=1i\ntest id=3i\n")).toBe(null);
+        expect(await assertSentData(proxies[1], "test id=2i\n")).toBe(null);
+        await pool.close();
+        await stopProxies(proxies);
+    });
+
+    it('sends the batches of a table to the same connection', async function () {
+        const proxies = await createProxies();
+        const pool = await createPool();
+        for (let i = 0; i < 3; i++) {
+            await pool.send(`test id=${i}i\n`, "test");
+        }
+        const expected = "test id=0i\ntest id=1i\ntest id=2i\n";
+        const results = [
+            await assertSentData(proxies[0], expected, 500),
+            await assertSentData(proxies[1], expected, 500)
+        ];
+        expect(results.filter(result => result === null).length).toBe(1);
+        await pool.close();
+        await stopProxies(proxies);
+    });
+
+    it('skips hosts it cannot connect to', async function () {
+        const proxies = await createProxies();
+        const pool = await createPool([PROXY_PORTS[0], UNUSED_PORT]);
+        expect(pool.size).toBe(1);
+        await pool.send("test id=1i\n");
+        await pool.send("test id=2i\n");
+        expect(await assertSentData(proxies[0], "test id=1i\ntest id=2i\n")).toBe(null);
+        await pool.close();
+        await stopProxies(proxies);
+    });
+
+    it('removes closed connections from the rotation', async function () {
+        const proxies = await createProxies();
+        const pool = await createPool();
+        await sleep(100);
+        proxies[1].client.destroy();
+        await sleep(100);
+        expect(pool.size).toBe(1);
+        await pool.send("test id=1i\n");
+        await pool.send("test id=2i\n");
+        expect(await assertSentData(proxies[0], "test id=1i\ntest id=2i\n")).toBe(null);
+        await pool.close();
+        await stopProxies(proxies);
+    });
+
+    it('sends the batch via another connection if the send fails', async function () {
+        const proxies = await createProxies();
+        const pool = await createPool();
+        pool.senders[0].send = async () => {
+            throw "write failed";
+        };
+        await pool.send("test id=1i\n");
+        await pool.send("test id=2i\n");
+        await pool.send("test id=3i\n");
+        expect(await assertSentData(proxies[1], "test id=1i\ntest id=2i\ntest id=3i\n")).toBe(null);
+        const connections = pool.getStats().connections;
+        expect(connections.map(connection => connection.healthy)).toEqual([false, true]);
+        expect(connections[0].failures).toBe(1);
+        await pool.close();
+        await stopProxies(proxies);
+    });
+
+    it('sends the batches via another connection if a connection is lost', async function () {
+        const proxies = await createProxies();
+        const pool = await createPool(PROXY_PORTS, { reconnect: true, reconnectInitialDelay: 10000 });
+        await sleep(100);
+        proxies[0].client.resetAndDestroy();
+        await proxies[0].stop();
+        await sleep(100);
+        // the reconnecting sender stays in the pool, but it is not used
+        expect(pool.size).toBe(2);
+        const connections = pool.getStats().connections;
+        expect(connections.map(connection => connection.healthy)).toEqual([false, true]);
+        expect(connections[0].failures).toBe(1);
+        await pool.send("test id=1i\n");
+        await pool.send("test id=2i\n");
+        await pool.send("test id=3i\n");
+        expect(await assertSentData(proxies[1], "test id=1i\ntest id=2i\ntest id=3i\n")).toBe(null);
+        expect(proxies[0].getDataSentToRemote().join('')).toBe("");
+        await pool.close();
+        await proxies[1].stop();
+    });
+
+    it('fails if the send fails via all connections', async function () {
+        const proxies = await createProxies();
+        const pool = await createPool();
+        for (const sender of pool.senders) {
+            sender.send = async () => {
+                throw "write failed";
+            };
+        }
+        await expect(pool.send("test id=1i\n")).rejects.toThrow("write failed");
+        expect(pool.getStats().connections.map(connection => connection.failures)).toEqual([1, 1]);
+        await pool.close();
+        await stopProxies(proxies);
+    });
+
+    it('prefers the connection with the lowest latency', async function () {
+        const proxies = await createProxies();
+        const pool = await createPool(PROXY_PORTS, { strategy: "leastLatency" });
+        const slow = pool.senders[0];
+        const send = slow.send.bind(slow);
+        slow.send = async data => {
+            await sleep(50);
+            return send(data);
+        };
+        for (let i = 1; i <= 5; i++) {
+            await pool.send(`test id=${i}i\n`);
+        }
+        expect(await assertSentData(proxies[0], "test id=1i\n")).toBe(null);
+        expect(await assertSentData(proxies[1], "test id=2i\ntest id=3i\ntest id=4i\ntest id=5i\n")).toBe(null);
+        const connections = pool.getStats().connections;
+        expect(connections[0].latency).toBeGreaterThan(connections[1].latency);
+        await pool.close();
+        await stopProxies(proxies);
+    });
+
+    it('throws exception if the strategy is unknown', function () {
+        expect(
+            () => new SenderPool(null, { strategy: "random" })
+        ).toThrow("Unknown strategy: random, available strategies: roundRobin, leastLatency");
+    });
+
+    it('throws exception if none of the hosts is available', async function () {
+        const pool = new SenderPool();
+        await expect(
+            pool.connect([{ port: UNUSED_PORT, host: PROXY_HOST }])
+        ).rejects.toThrow("Could not connect to any of the hosts");
+    });
+});
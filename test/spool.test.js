@@ -0,0 +1,193 @@
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const { Sender } = require("../index");
+const { Spool } = require("../src/spool");
+const { MockProxy } = require("./mockproxy");
+
+// each test file listens on its own port, jest runs the files in parallel
+const PROXY_PORT = 9106;
+const PROXY_HOST = '127.0.0.1';
+
+async function sleep(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+function createDirectory() {
+    return fs.mkdtempSync(path.join(os.tmpdir(), "questdb-spool-"));
+}
+
+function readAll(spool) {
+    const batches = [];
+    let data;
+    while ((data = spool.peek()) !== null) {
+        batches.push(data.toString());
+        spool.shift();
+    }
+    return batches;
+}
+
+describe('Spool test suite', function () {
+    it('returns the batches in the order they were appended', function () {
+        const directory = createDirectory();
+        const spool = new Spool({ directory: directory, segmentSize: 20 });
+        expect(spool.empty).toBe(true);
+        spool.append("test id=1i\n");
+        spool.append(Buffer.from("test id=2i\n"));
+        spool.append("test id=3i\n");
+        expect(spool.empty).toBe(false);
+        // a new segment is started when the current one reaches segmentSize
+        expect(fs.readdirSync(directory)).toEqual(["000000000001.spool", "000000000002.spool"]);
+
+        expect(spool.peek().toString()).toBe("test id=1i\n");
+        expect(readAll(spool)).toEqual(["test id=1i\n", "test id=2i\n", "test id=3i\n"]);
+        expect(spool.empty).toBe(true);
+        expect(fs.readdirSync(directory)).toEqual([]);
+        spool.close();
+        fs.rmSync(directory, { recursive: true });
+    });
+
+    it('keeps the batches across restarts', function () {
+        const directory = createDirectory();
+        const spool = new Spool({ directory: directory });
+        spool.append("test id=1i\n");
+        spool.append("test id=2i\n");
+        spool.close();
+        // the process stopped while a batch was appended
+        fs.appendFileSync(path.join(directory, "000000000001.spool"), Buffer.from([100, 0, 0, 0, 1, 2]));
+
+        const reopened = new Spool({ directory: directory });
+        expect(reopened.peek().toString()).toBe("test id=1i\n");
+        reopened.shift();
+        reopened.append("test id=3i\n");
+        expect(readAll(reopened)).toEqual(["test id=2i\n", "test id=3i\n"]);
+        expect(
+            () => new Spool({ directory: directory, maxSize: 10 }).append("test id=4i\n")
+        ).toThrow("Spool is full [size=0, maxSize=10]");
+        reopened.close();
+        fs.rmSync(directory, { recursive: true });
+    });
+
+    it('reads each record from the disk once', function () {
+        const directory = createDirectory();
+        const spool = new Spool({ directory: directory });
+        spool.append("test id=1i\n");
+        spool.append("test id=2i\n");
+        const readSync = fs.readSync;
+        let reads = 0;
+        fs.readSync = function () {
+            reads++;
+            return readSync.apply(this, arguments);
+        };
+        try {
+            // the header and the data
+            expect(spool.peek().toString()).toBe("test id=1i\n");
+            spool.shift();
+            expect(reads).toBe(2);
+            // only the header
+            spool.shift();
+            expect(reads).toBe(3);
+        } finally {
+            fs.readSync = readSync;
+        }
+        expect(spool.peek()).toBe(null);
+        spool.close();
+        fs.rmSync(directory, { recursive: true });
+    });
+
+    it('spools the batches while the sender is disconnected and sends them after reconnecting', async function () {
+        const directory = createDirectory();
+        let proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        const sender = new Sender(null, {
+            reconnect: true,
+            reconnectInitialDelay: 100,
+            spool: { directory: directory, syncInterval: 10 }
+        });
+        expect(await sender.connect(PROXY_PORT, PROXY_HOST)).toBe(true);
+        await sender.send("test id=1i\n");
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe("test id=1i\n");
+
+        proxy.client.destroy();
+        await proxy.stop();
+        await sleep(20);
+        await sender.send("test id=2i\n");
+        await sender.send("test id=3i\n");
+        expect(sender.spool.empty).toBe(false);
+        expect(fs.readdirSync(directory).length).toBe(1);
+
+        proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        await new Promise(resolve => sender.once("reconnect", resolve));
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe("test id=2i\ntest id=3i\n");
+        expect(sender.spool.empty).toBe(true);
+        expect(fs.readdirSync(directory)).toEqual([]);
+
+        // sent directly again
+        await sender.send("test id=4i\n");
+        expect(sender.spool.empty).toBe(true);
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe("test id=2i\ntest id=3i\ntest id=4i\n");
+        await sender.close();
+        await proxy.stop();
+        fs.rmSync(directory, { recursive: true });
+    });
+
+    it('keeps reconnecting with a spool instead of giving up', async function () {
+        const directory = createDirectory();
+        let proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        const sender = new Sender(null, {
+            reconnect: true,
+            reconnectInitialDelay: 50,
+            reconnectMaxDelay: 50,
+            reconnectMaxRetries: 1,
+            spool: { directory: directory, syncInterval: 10 }
+        });
+        await sender.connect(PROXY_PORT, PROXY_HOST);
+        await sleep(100);
+        proxy.client.destroy();
+        await proxy.stop();
+        await sleep(20);
+        await sender.send("test id=1i\n");
+
+        // several attempts fail while the server is down
+        await sleep(400);
+        proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        await new Promise(resolve => sender.once("reconnect", resolve));
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe("test id=1i\n");
+        expect(sender.stats.reconnects).toBe(1);
+        await sender.close();
+        await proxy.stop();
+        fs.rmSync(directory, { recursive: true });
+    });
+
+    it('does not exit on a connection error with a spool', async function () {
+        const directory = createDirectory();
+        let proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        const sender = new Sender(null, { spool: { directory: directory, syncInterval: 10 } });
+        await sender.connect(PROXY_PORT, PROXY_HOST);
+        await sleep(100);
+        proxy.client.resetAndDestroy();
+        await proxy.stop();
+        await sleep(100);
+        expect(sender.connected).toBe(false);
+        await sender.send("test id=1i\n");
+        expect(sender.spool.empty).toBe(false);
+
+        proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        await sender.connect(PROXY_PORT, PROXY_HOST);
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe("test id=1i\n");
+        expect(sender.spool.empty).toBe(true);
+        await sender.close();
+        await proxy.stop();
+        fs.rmSync(directory, { recursive: true });
+    });
+});
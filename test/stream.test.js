@@ -0,0 +1,83 @@
+const { Readable } = require("stream");
+const { pipeline } = require("stream/promises");
+const { Sender } = require("../index");
+const { MockProxy } = require("./mockproxy");
+
+// each test file listens on its own port, jest runs the files in parallel
+const PROXY_PORT = 9107;
+const PROXY_HOST = '127.0.0.1';
+
+async function sleep(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+async function* generateRows(numOfRows) {
+    for (let i = 0; i < numOfRows; i++) {
+        yield {
+            table: "test",
+            symbols: { location: i % 2 ? "us" : "eu" },
+            columns: { temperature: 17.5, id: { type: "integer", value: i }, note: null },
+            timestamp: 1658484765000000000n + BigInt(i)
+        };
+    }
+}
+
+function expectedRows(numOfRows) {
+    let expected = "";
+    for (let i = 0; i < numOfRows; i++) {
+        expected += `test,location=${i % 2 ? "us" : "eu"} temperature=17.5,id=${i}i ${1658484765000000000n + BigInt(i)}\n`;
+    }
+    return expected;
+}
+
+describe('SenderWritable test suite', function () {
+    it('can ingest rows from an async iterable', async function () {
+        const proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        const sender = new Sender();
+        expect(await sender.connect(PROXY_PORT, PROXY_HOST)).toBe(true);
+
+        const flush = sender.flush;
+        let flushes = 0;
+        sender.flush = function () {
+            flushes++;
+            return flush.call(this);
+        };
+        expect(await sender.ingest(generateRows(25), { flushRows: 10 })).toBe(25);
+        expect(flushes).toBe(3);
+        expect(sender.pendingRows).toBe(0);
+
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe(expectedRows(25));
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('can be piped into', async function () {
+        const proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        const sender = new Sender();
+        expect(await sender.connect(PROXY_PORT, PROXY_HOST)).toBe(true);
+
+        await pipeline(Readable.from(generateRows(3)), sender.writable());
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe(expectedRows(3));
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('discards an invalid row and fails the stream', async function () {
+        const sender = new Sender();
+        const rows = [
+            { table: "test", columns: { id: { type: "integer", value: 1 } } },
+            { table: "test", columns: { id: { type: "integer", value: 1.5 } } }
+        ];
+        const writable = sender.writable();
+        writable.on("error", () => {});
+        writable.write(rows[0]);
+        writable.write(rows[1]);
+        const error = await new Promise(resolve => writable.on("error", resolve));
+        expect(error).toBe("Field value must be an integer, received 1.5");
+        expect(sender.builder.toBuffer().toString()).toBe("test id=1i\n");
+    });
+});
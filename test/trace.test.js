@@ -0,0 +1,122 @@
+const diagnostics = require("diagnostics_channel");
+const { PerformanceObserver } = require("perf_hooks");
+const { Builder, Sender, configureTracing, getPhaseTimings, resetPhaseTimings } = require("../index");
+const { MockProxy } = require("./mockproxy");
+
+// each test file listens on its own port, jest runs the files in parallel
+const PROXY_PORT = 9108;
+const PROXY_HOST = '127.0.0.1';
+
+function subscribe(name, events) {
+    const handlers = {
+        start: message => events.push(`${name}:start`),
+        end: message => events.push(`${name}:end`),
+        asyncStart: message => events.push(`${name}:asyncStart`),
+        asyncEnd: message => events.push(`${name}:asyncEnd`),
+        error: message => events.push(`${name}:error`)
+    };
+    const channel = diagnostics.tracingChannel(name);
+    channel.subscribe(handlers);
+    return () => channel.unsubscribe(handlers);
+}
+
+describe('Tracing test suite', function () {
+    it('publishes the toBuffer span to the tracing channel', function () {
+        const events = [];
+        const unsubscribe = subscribe("questdb:builder:toBuffer", events);
+        const builder = new Builder(256);
+        builder.addTable("test").addInteger("id", 1).atNow();
+        builder.toBuffer();
+        expect(() => new Builder(256).toBuffer()).toThrow("The builder is empty");
+        unsubscribe();
+        expect(events).toEqual([
+            "questdb:builder:toBuffer:start", "questdb:builder:toBuffer:end",
+            "questdb:builder:toBuffer:start", "questdb:builder:toBuffer:error", "questdb:builder:toBuffer:end"
+        ]);
+    });
+
+    it('publishes the handshake and flush spans of the sender', async function () {
+        const events = [];
+        const contexts = [];
+        const unsubscribeHandshake = subscribe("questdb:sender:handshake", events);
+        const unsubscribeFlush = subscribe("questdb:sender:flush", events);
+        const onStart = message => contexts.push([message.sequence, message.rows, message.bytes]);
+        diagnostics.subscribe("tracing:questdb:sender:flush:start", onStart);
+
+        const proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        const sender = new Sender();
+        await sender.connect(PROXY_PORT, PROXY_HOST);
+        sender.addTable("test").addInteger("id", 1).atNow();
+        await sender.flush();
+        await sender.close();
+        await proxy.stop();
+        unsubscribeHandshake();
+        unsubscribeFlush();
+        diagnostics.unsubscribe("tracing:questdb:sender:flush:start", onStart);
+
+        expect(events).toEqual([
+            "questdb:sender:handshake:start", "questdb:sender:handshake:end",
+            "questdb:sender:handshake:asyncStart", "questdb:sender:handshake:asyncEnd",
+            "questdb:sender:flush:start", "questdb:sender:flush:end",
+            "questdb:sender:flush:asyncStart", "questdb:sender:flush:asyncEnd"
+        ]);
+        expect(contexts).toEqual([[1, 1, 11]]);
+    });
+
+    it('creates performance entries for the spans if marks are enabled', async function () {
+        const entries = [];
+        const observer = new PerformanceObserver(list => entries.push(...list.getEntries()));
+        observer.observe({ entryTypes: ["measure"] });
+        configureTracing({ marks: true, sampleRate: 0 });
+        const builder = new Builder(256);
+        builder.addTable("test").addInteger("id", 1).atNow();
+        builder.toBuffer();
+        configureTracing({ sampleRate: 0 });
+        builder.toBuffer();
+        await new Promise(resolve => setTimeout(resolve, 100));
+        observer.disconnect();
+
+        expect(entries.map(entry => entry.name)).toEqual(["questdb:builder:toBuffer"]);
+        expect(entries[0].duration).toBeGreaterThanOrEqual(0);
+    });
+
+    it('times the phases of the sampled rows', function () {
+        resetPhaseTimings();
+        configureTracing({ sampleRate: 1 });
+        const builder = new Builder(1024);
+        builder.addTable("phase_test").addSymbol("phase_symbol", "a b").addFloat("phase_load", 0.5).at(1658484765000000000);
+        builder.addTable("phase_test").addString("phase_name", "x").addInteger("phase_id", 2).atNow();
+        configureTracing({ sampleRate: 0 });
+        new Builder(1024).addTable("phase_test").addInteger("phase_id", 3).atNow();
+
+        const timings = getPhaseTimings();
+        // the names are validated and escaped only the first time they are written
+        expect(timings.validation.count).toBe(5);
+        expect(timings.escaping.count).toBe(7);
+        expect(timings.numbers.count).toBe(3);
+        expect(timings.write.count).toBe(0);
+        expect(timings.numbers.time).toBeGreaterThanOrEqual(0);
+        expect(timings.numbers.mean).toBe(timings.numbers.time / 3);
+        resetPhaseTimings();
+        expect(getPhaseTimings().numbers.count).toBe(0);
+    });
+
+    it('samples every n-th row', function () {
+        resetPhaseTimings();
+        configureTracing({ sampleRate: 0.25 });
+        const builder = new Builder(1024);
+        for (let i = 0; i < 8; i++) {
+            builder.addTable("test").addInteger("id", i).atNow();
+        }
+        configureTracing({ sampleRate: 0 });
+        expect(getPhaseTimings().numbers.count).toBe(2);
+        resetPhaseTimings();
+    });
+
+    it('throws exception if the sample rate is invalid', function () {
+        expect(
+            () => configureTracing({ sampleRate: 2 })
+        ).toThrow("Sample rate must be a number between 0 and 1, received 2");
+    });
+});
@@ -0,0 +1,62 @@
+const path = require("path");
+const { Worker } = require("worker_threads");
+const { Sender, connectWorker } = require("../index");
+const { MockProxy } = require("./mockproxy");
+
+// each test file listens on its own port, jest runs the files in parallel
+const PROXY_PORT = 9109;
+const PROXY_HOST = '127.0.0.1';
+
+const WORKER_CODE = `
+    const { parentPort } = require("worker_threads");
+    const { WorkerBuilder } = require(${JSON.stringify(path.resolve(__dirname, "../index"))});
+
+    async function run() {
+        const builder = new WorkerBuilder(1024);
+        builder.addTable("test").addInteger("id", 1).atNow();
+        builder.addTable("test").addInteger("id", 2).atNow();
+        const shared = builder.buffer.buffer instanceof SharedArrayBuffer;
+        await builder.flush();
+        builder.addTable("test").addInteger("id", 3).atNow();
+        await builder.flush();
+        parentPort.postMessage({ done: true, shared: shared });
+    }
+
+    run().catch(err => parentPort.postMessage({ done: true, error: err.toString() }));
+`;
+
+async function sleep(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+describe('WorkerBuilder test suite', function () {
+    it('sends the batches built in a worker thread via the sender of the main thread', async function () {
+        const proxy = new MockProxy({ auth: false, assertions: true });
+        await proxy.start(PROXY_PORT);
+        const sender = new Sender();
+        expect(await sender.connect(PROXY_PORT, PROXY_HOST)).toBe(true);
+
+        const worker = new Worker(WORKER_CODE, { eval: true });
+        connectWorker(worker, sender);
+        const result = await new Promise(resolve => worker.on("message", message => {
+            if (message.done) {
+                resolve(message);
+            }
+        }));
+        expect(result.error).toBeUndefined();
+        expect(result.shared).toBe(true);
+        await worker.terminate();
+
+        await sleep(100);
+        expect(proxy.getDataSentToRemote().join('')).toBe("test id=1i\ntest id=2i\ntest id=3i\n");
+        await sender.close();
+        await proxy.stop();
+    });
+
+    it('cannot be used outside of a worker thread without a port', function () {
+        const { WorkerBuilder } = require("../index");
+        expect(
+            () => new WorkerBuilder(1024)
+        ).toThrow("WorkerBuilder has to be used in a worker thread, or a port has to be passed in the options");
+    });
+});